@@ -0,0 +1,73 @@
+#include "synthetic.h"
+
+//writes one generated left/right pair, e.g. to reproduce a large file run of jsondiff
+int main(int argc, char * argv[])
+{
+    Linus::jsondiff::SyntheticSpec spec(1000, 2, 8, 0.1, 1);
+    std::size_t bytes = 0;
+    std::string left, right;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            continue;
+        }
+        if (arg == "-left")
+        {
+            left = argv[++i];
+            continue;
+        }
+        if (arg == "-right")
+        {
+            right = argv[++i];
+            continue;
+        }
+        if (arg == "-mutations")
+        {
+            if (!spec.set_mutations(argv[++i]))
+            {
+                std::cerr << "Invalid mutations: " << argv[i] << std::endl;
+            }
+            continue;
+        }
+        try
+        {
+            if (arg == "-size") spec.size = std::max(1ul, std::stoul(argv[++i]));
+            else if (arg == "-bytes") bytes = std::stoull(argv[++i]);
+            else if (arg == "-depth") spec.depth = std::stoul(argv[++i]);
+            else if (arg == "-width") spec.width = std::max(1ul, std::stoul(argv[++i]));
+            else if (arg == "-change") spec.change_rate = std::stod(argv[++i]);
+            else if (arg == "-seed") spec.seed = std::stoull(argv[++i]);
+        }
+        catch (const std::invalid_argument& e)
+        {
+            std::cerr << "Invalid value for " << arg << ": " << argv[i] << std::endl;
+        }
+        catch (const std::out_of_range& e)
+        {
+            std::cerr << "Value out of range for " << arg << ": " << argv[i] << std::endl;
+        }
+    }
+    if (left.empty() || right.empty())
+    {
+        std::cerr << "Usage: generate -left path -right path [-size n | -bytes b] [-depth d] [-width w] [-change r] [-mutations list] [-seed s]" << std::endl;
+        return 1;
+    }
+    if (bytes > 0)
+    {
+        spec.fit_bytes(bytes);
+    }
+    Linus::jsondiff::SyntheticPair pair(spec);
+    std::ofstream left_file(left, std::ios::out | std::ios::binary);
+    std::ofstream right_file(right, std::ios::out | std::ios::binary);
+    if (!left_file.is_open() || !right_file.is_open())
+    {
+        std::cerr << "Cannot open file: " << (left_file.is_open() ? right : left) << std::endl;
+        return 1;
+    }
+    left_file << pair.left;
+    right_file << pair.right;
+    std::cout << spec.size << " elements: " << pair.left.size() << " + " << pair.right.size() << " bytes\n";
+    return 0;
+}
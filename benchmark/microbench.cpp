@@ -0,0 +1,236 @@
+#include "synthetic.h"
+#include <new>
+#include <cstdlib>
+
+//every operator new in the process goes through here, the kernels' allocations are the difference around a run
+static std::atomic<std::uint64_t> allocation_count(0);
+
+void* operator new(std::size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    void* pointer = std::malloc(size == 0 ? 1 : size);
+    if (pointer == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept
+{
+    std::free(pointer);
+}
+
+//one kernel call is an op; bytes is the input text one run of all calls walks over
+class Kernel
+{
+    public:
+        std::string name;
+        unsigned int calls;
+        std::size_t bytes;
+        std::function<void()> run;
+        Kernel(const std::string& name_input, unsigned int calls_input, std::size_t bytes_input, std::function<void()> run_input) : name(name_input), calls(calls_input), bytes(bytes_input), run(run_input) {}
+};
+
+//the similarity cache and the reported records are cleared before every run, so that neither memoised scores nor the
+//growth of a records map filled by the previous runs are measured
+void measure(Linus::jsondiff::JsonDiffer& differ, Kernel& kernel, unsigned int iterations)
+{
+    differ.cache.clear();
+    differ.records.clear();
+    kernel.run();
+    double seconds = 0;
+    std::uint64_t allocations = 0;
+    for (unsigned int iteration = 0; iteration < iterations; ++iteration)
+    {
+        differ.cache.clear();
+        differ.records.clear();
+        std::uint64_t before = allocation_count.load();
+        auto start = std::chrono::steady_clock::now();
+        kernel.run();
+        auto finish = std::chrono::steady_clock::now();
+        allocations += allocation_count.load() - before;
+        seconds += std::chrono::duration<double>(finish - start).count();
+    }
+    double ops = static_cast<double>(kernel.calls) * iterations;
+    std::cout << kernel.name << ": " << seconds * 1e9 / ops << " ns/op, " << allocations / ops << " allocs/op, " << kernel.bytes * iterations / seconds / 1e6 << " MB/s\n";
+}
+
+int main(int argc, char * argv[])
+{
+    unsigned int size = 200;
+    unsigned int depth = 2;
+    unsigned int width = 8;
+    double change_rate = 0.1;
+    std::uint64_t seed = 1;
+    unsigned int iterations = 5;
+    int thread_count = 1;
+    double similarity_threshold = 0.5;
+    std::string only;
+    std::string mutations = "all";
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "-kernel" && i + 1 < argc)
+        {
+            only = argv[++i];
+            continue;
+        }
+        if (arg == "-mutations" && i + 1 < argc)
+        {
+            mutations = argv[++i];
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            continue;
+        }
+        try
+        {
+            if (arg == "-size") size = std::max(1ul, std::stoul(argv[++i]));
+            else if (arg == "-depth") depth = std::stoul(argv[++i]);
+            else if (arg == "-width") width = std::stoul(argv[++i]);
+            else if (arg == "-change") change_rate = std::stod(argv[++i]);
+            else if (arg == "-seed") seed = std::stoull(argv[++i]);
+            else if (arg == "-iterations") iterations = std::max(1ul, std::stoul(argv[++i]));
+            else if (arg == "-N") thread_count = std::max(1, std::stoi(argv[++i]));
+            else if (arg == "-S") similarity_threshold = std::stod(argv[++i]);
+        }
+        catch (const std::invalid_argument& e)
+        {
+            std::cerr << "Invalid value for " << arg << ": " << argv[i] << std::endl;
+        }
+        catch (const std::out_of_range& e)
+        {
+            std::cerr << "Value out of range for " << arg << ": " << argv[i] << std::endl;
+        }
+    }
+
+    Linus::jsondiff::SyntheticSpec spec(size, depth, width, change_rate, seed);
+    if (!spec.set_mutations(mutations))
+    {
+        std::cerr << "Invalid mutations: " << mutations << std::endl;
+    }
+    Linus::jsondiff::SyntheticPair pair(spec);
+    rapidjson::Document left_document, right_document;
+    left_document.Parse(pair.left.c_str());
+    right_document.Parse(pair.right.c_str());
+    const rapidjson::Value& left = left_document;
+    const rapidjson::Value& right = right_document;
+    std::cout << "size " << size << ", depth " << depth << ", width " << width << ", change " << change_rate << ", seed " << seed << ": " << pair.left.size() << " + " << pair.right.size() << " bytes\n";
+
+    Linus::jsondiff::JsonDiffer differ(left, right, true, false, similarity_threshold, thread_count);
+    unsigned int len_left = left.Size();
+    unsigned int len_right = right.Size();
+    unsigned int min_len = std::min(len_left, len_right);
+    std::size_t left_bytes = pair.left.size();
+    std::size_t both_bytes = pair.left.size() + pair.right.size();
+    std::vector<int> type_left(len_left);
+    std::vector<int> type_right(len_right);
+    std::vector<std::uint64_t> hash_left(len_left);
+    std::vector<std::uint64_t> hash_right(len_right);
+    for (unsigned int i = 0; i < len_left; ++i)
+    {
+        type_left[i] = differ.get_type(left[i]);
+        hash_left[i] = differ.get_hash(left[i]);
+    }
+    for (unsigned int j = 0; j < len_right; ++j)
+    {
+        type_right[j] = differ.get_type(right[j]);
+        hash_right[j] = differ.get_hash(right[j]);
+    }
+    std::vector<double> score(len_right + 1, 0.0);
+    Linus::jsondiff::TreeLevel level(left, right);
+
+    std::vector<Kernel> kernels;
+    kernels.emplace_back("get_type", len_left, left_bytes, [&]()
+    {
+        for (unsigned int i = 0; i < len_left; ++i) differ.get_type(left[i]);
+    });
+    if (depth > 0)
+    {
+        kernels.emplace_back("drill_obj", min_len, both_bytes, [&]()
+        {
+            for (unsigned int i = 0; i < min_len; ++i) differ.drill_obj(left[i], right[i], 0.0);
+        });
+        kernels.emplace_back("compare_object", min_len, both_bytes, [&]()
+        {
+            for (unsigned int i = 0; i < min_len; ++i) differ.compare_object(Linus::jsondiff::TreeLevel(left[i], right[i]), true);
+        });
+    }
+    kernels.emplace_back("drill_LCS", 1, both_bytes, [&]()
+    {
+        differ.drill_LCS(left, right, 0.0);
+    });
+    kernels.emplace_back("LCS", 1, both_bytes, [&]()
+    {
+        differ.LCS(level);
+    });
+    kernels.emplace_back("NWScore", 1, both_bytes, [&]()
+    {
+        //NWScore and the starter take inclusive ends, so both sides need an element
+        if (len_left > 0 && len_right > 0) differ.NWScore(false, level, true, type_left, hash_left, 0, len_left - 1, type_right, hash_right, 0, len_right - 1, score.data());
+    });
+    kernels.emplace_back("Hirschberg", 1, both_bytes, [&]()
+    {
+        if (len_left > 0 && len_right > 0) differ.Hirschberg_starter(level);
+    });
+    kernels.emplace_back("parallel_LCS", 1, both_bytes, [&]()
+    {
+        differ.parallel_LCS(level, type_left, hash_left, 0, len_left, type_right, hash_right, 0, len_right);
+    });
+    kernels.emplace_back("ValueToString", 1, left_bytes, [&]()
+    {
+        Linus::jsondiff::ValueToString(left);
+    });
+
+    for (auto& kernel : kernels)
+    {
+        if (only.empty() || only == kernel.name)
+        {
+            measure(differ, kernel, iterations);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,185 @@
+#include "synthetic.h"
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//one jsondiff run; peak_rss is in KB and stays -1 where the platform cannot report it
+class SweepRun
+{
+    public:
+        double wall;
+        long peak_rss;
+        long long output_size;
+        int status;
+        SweepRun() : wall(0), peak_rss(-1), output_size(0), status(-1) {}
+};
+
+std::vector<std::string> split_list(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+//runs the command with its console output discarded; the differences go to output, whose size is recorded
+SweepRun run_jsondiff(std::vector<std::string>& command, const std::string& output)
+{
+    SweepRun result;
+    std::remove(output.c_str());
+    auto start = std::chrono::steady_clock::now();
+#ifndef _WIN32
+    std::vector<char*> args;
+    for (auto& arg : command)
+    {
+        args.push_back(&arg[0]);
+    }
+    args.push_back(nullptr);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, 1);
+        dup2(null, 2);
+        execvp(args[0], args.data());
+        _exit(127);
+    }
+    int status = 0;
+    struct rusage usage;
+    if (pid > 0 && wait4(pid, &status, 0, &usage) == pid)
+    {
+        result.status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        result.peak_rss = usage.ru_maxrss;
+    }
+#else
+    std::string line;
+    for (const auto& arg : command)
+    {
+        line += "\"" + arg + "\" ";
+    }
+    result.status = std::system((line + "> NUL 2>&1").c_str());
+#endif
+    result.wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::ifstream file(output, std::ios::in | std::ios::binary | std::ios::ate);
+    if (file.is_open())
+    {
+        result.output_size = static_cast<long long>(file.tellg());
+    }
+    std::remove(output.c_str());
+    return result;
+}
+
+//generates one pair per size and runs jsondiff on it for every mode and thread count, one CSV row per run
+int main(int argc, char * argv[])
+{
+    Linus::jsondiff::SyntheticSpec spec(0, 2, 8, 0.1, 1);
+    std::string jsondiff = "./jsondiff";
+    std::string sizes = "1000000,4000000,16000000";
+    std::string threads = "1,2,4";
+    std::string modes = "fast,advanced,hirschberg";
+    std::string directory = ".";
+    std::string csv;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            continue;
+        }
+        if (arg == "-jsondiff") jsondiff = argv[++i];
+        else if (arg == "-bytes") sizes = argv[++i];
+        else if (arg == "-N") threads = argv[++i];
+        else if (arg == "-modes") modes = argv[++i];
+        else if (arg == "-dir") directory = argv[++i];
+        else if (arg == "-output" || arg == "-O") csv = argv[++i];
+        else if (arg == "-mutations")
+        {
+            if (!spec.set_mutations(argv[++i]))
+            {
+                std::cerr << "Invalid mutations: " << argv[i] << std::endl;
+            }
+        }
+        else
+        {
+            try
+            {
+                if (arg == "-depth") spec.depth = std::stoul(argv[++i]);
+                else if (arg == "-width") spec.width = std::max(1ul, std::stoul(argv[++i]));
+                else if (arg == "-change") spec.change_rate = std::stod(argv[++i]);
+                else if (arg == "-seed") spec.seed = std::stoull(argv[++i]);
+            }
+            catch (const std::invalid_argument& e)
+            {
+                std::cerr << "Invalid value for " << arg << ": " << argv[i] << std::endl;
+            }
+            catch (const std::out_of_range& e)
+            {
+                std::cerr << "Value out of range for " << arg << ": " << argv[i] << std::endl;
+            }
+        }
+    }
+
+    std::ofstream file;
+    std::ostream* out = &std::cout;
+    if (!csv.empty())
+    {
+        file.open(csv, std::ios::out | std::ios::binary);
+        if (!file.is_open())
+        {
+            std::cerr << "Cannot open file: " << csv << std::endl;
+            return 1;
+        }
+        out = &file;
+    }
+    *out << "elements,left_bytes,right_bytes,mode,threads,wall_s,peak_rss_kb,output_bytes,status\n";
+
+    std::string left = directory + "/sweep-left.json";
+    std::string right = directory + "/sweep-right.json";
+    std::string output = directory + "/sweep-output.jsonl";
+    for (const auto& size : split_list(sizes))
+    {
+        try
+        {
+            spec.fit_bytes(std::stoull(size));
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Invalid size: " << size << std::endl;
+            continue;
+        }
+        Linus::jsondiff::SyntheticPair pair(spec);
+        {
+            std::ofstream left_file(left, std::ios::out | std::ios::binary);
+            std::ofstream right_file(right, std::ios::out | std::ios::binary);
+            if (!left_file.is_open() || !right_file.is_open())
+            {
+                std::cerr << "Cannot open file: " << (left_file.is_open() ? right : left) << std::endl;
+                return 1;
+            }
+            left_file << pair.left;
+            right_file << pair.right;
+        }
+        for (const auto& mode : split_list(modes))
+        {
+            for (const auto& thread_count : split_list(threads))
+            {
+                std::vector<std::string> command = {jsondiff, "-left", left, "-right", right, "-N", thread_count, "-O", output};
+                if (mode == "advanced" || mode == "hirschberg") command.push_back("-A");
+                if (mode == "hirschberg") command.push_back("-H");
+                SweepRun run = run_jsondiff(command, output);
+                *out << spec.size << "," << pair.left.size() << "," << pair.right.size() << "," << mode << "," << thread_count << ","
+                     << run.wall << "," << run.peak_rss << "," << run.output_size << "," << run.status << std::endl;
+            }
+        }
+    }
+    std::remove(left.c_str());
+    std::remove(right.c_str());
+    return 0;
+}
@@ -0,0 +1,228 @@
+#include "synthetic.h"
+using namespace std;
+using namespace Linus::jsondiff;
+using namespace rapidjson;
+
+Linus::jsondiff::SyntheticSpec::SyntheticSpec(unsigned int size_input, unsigned int depth_input, unsigned int width_input, double change_rate_input, std::uint64_t seed_input) : size(size_input), depth(depth_input), width(std::max(1u, width_input)), change_rate(change_rate_input), seed(seed_input), mutations(ALL)
+{
+
+}
+
+//picks the element count whose left side comes closest to bytes, measured on a sample of 64 elements
+void Linus::jsondiff::SyntheticSpec::fit_bytes(std::size_t bytes)
+{
+    Linus::jsondiff::SyntheticSpec sample(*this);
+    sample.size = 64;
+    sample.change_rate = 0;
+    Linus::jsondiff::SyntheticPair pair(sample);
+    size = static_cast<unsigned int>(std::max<std::size_t>(1, bytes * sample.size / std::max<std::size_t>(1, pair.left.size())));
+}
+
+//comma separated names out of edit, remove, insert, move and rename, or "all"
+bool Linus::jsondiff::SyntheticSpec::set_mutations(const std::string& list)
+{
+    unsigned int result = 0;
+    std::stringstream stream(list);
+    std::string name;
+    while (std::getline(stream, name, ','))
+    {
+        if (name == "all") result |= ALL;
+        else if (name == "edit") result |= EDIT;
+        else if (name == "remove") result |= REMOVE;
+        else if (name == "insert") result |= INSERT;
+        else if (name == "move") result |= MOVE;
+        else if (name == "rename") result |= RENAME;
+        else return false;
+    }
+    mutations = result;
+    return true;
+}
+
+Linus::jsondiff::SyntheticRandom::SyntheticRandom(std::uint64_t seed) : state(seed)
+{
+
+}
+
+//splitmix64, unlike the std distributions its sequence does not depend on the standard library
+std::uint64_t Linus::jsondiff::SyntheticRandom::next()
+{
+    std::uint64_t x = (state += 0x9e3779b97f4a7c15ULL);
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+double Linus::jsondiff::SyntheticRandom::uniform()
+{
+    return (next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+Linus::jsondiff::SyntheticPair::SyntheticPair(const Linus::jsondiff::SyntheticSpec& spec)
+{
+    Linus::jsondiff::SyntheticRandom seeds(spec.seed);
+    std::vector<std::uint64_t> element_seeds(spec.size);
+    for (unsigned int k = 0; k < spec.size; ++k)
+    {
+        element_seeds[k] = seeds.next();
+    }
+
+    rapidjson::StringBuffer left_buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> left_writer(left_buffer);
+    left_writer.StartArray();
+    for (unsigned int k = 0; k < spec.size; ++k)
+    {
+        write_element(left_writer, spec, element_seeds[k], 0);
+    }
+    left_writer.EndArray();
+    left = left_buffer.GetString();
+
+    std::vector<unsigned int> kinds;
+    for (unsigned int kind = Linus::jsondiff::SyntheticSpec::EDIT; kind <= Linus::jsondiff::SyntheticSpec::RENAME; kind <<= 1)
+    {
+        if (spec.mutations & kind) kinds.push_back(kind);
+    }
+    //one roll per left element decides whether it is kept or which mutation it gets; moved elements wait in moved
+    //until the position they were sent to comes up
+    Linus::jsondiff::SyntheticRandom changes(spec.seed ^ 0x5851f42d4c957f2dULL);
+    std::vector<std::pair<unsigned int, std::uint64_t>> moved;
+    rapidjson::StringBuffer right_buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> right_writer(right_buffer);
+    right_writer.StartArray();
+    for (unsigned int k = 0; k < spec.size; ++k)
+    {
+        for (auto iter = moved.begin(); iter != moved.end();)
+        {
+            if (iter->first > k)
+            {
+                ++iter;
+                continue;
+            }
+            write_element(right_writer, spec, iter->second, 0);
+            iter = moved.erase(iter);
+        }
+        if (kinds.empty() || changes.uniform() >= spec.change_rate)
+        {
+            write_element(right_writer, spec, element_seeds[k], 0);
+            continue;
+        }
+        switch (kinds[changes.next() % kinds.size()])
+        {
+            case Linus::jsondiff::SyntheticSpec::EDIT:
+                write_element(right_writer, spec, element_seeds[k], Linus::jsondiff::SyntheticSpec::EDIT);
+                break;
+            case Linus::jsondiff::SyntheticSpec::REMOVE:
+                break;
+            case Linus::jsondiff::SyntheticSpec::INSERT:
+                write_element(right_writer, spec, seeds.next(), 0);
+                write_element(right_writer, spec, element_seeds[k], 0);
+                break;
+            case Linus::jsondiff::SyntheticSpec::MOVE:
+                moved.emplace_back(k + 1 + static_cast<unsigned int>(changes.next() % (spec.size / 10 + 1)), element_seeds[k]);
+                break;
+            default:
+                write_element(right_writer, spec, element_seeds[k], Linus::jsondiff::SyntheticSpec::RENAME);
+                break;
+        }
+    }
+    for (const auto& element : moved)
+    {
+        write_element(right_writer, spec, element.second, 0);
+    }
+    right_writer.EndArray();
+    right = right_buffer.GetString();
+}
+
+void Linus::jsondiff::SyntheticPair::write_element(rapidjson::Writer<rapidjson::StringBuffer>& writer, const Linus::jsondiff::SyntheticSpec& spec, std::uint64_t seed, unsigned int mutation)
+{
+    Linus::jsondiff::SyntheticRandom random(seed);
+    if (spec.depth == 0)
+    {
+        //a small alphabet so that the two sides share values; integers have no keys, so a rename edits them too
+        int value = static_cast<int>(random.next() % (spec.size + 1));
+        writer.Int(mutation != 0 ? value + static_cast<int>(spec.size) + 1 : value);
+        return;
+    }
+    //the mutated member is drawn from its own stream so the rest of the element stays the same
+    unsigned int edited = spec.width;
+    unsigned int renamed = spec.width;
+    Linus::jsondiff::SyntheticRandom pick(seed ^ 0x2545f4914f6cdd1dULL);
+    if (mutation == Linus::jsondiff::SyntheticSpec::EDIT)
+    {
+        unsigned int scalars = (spec.depth > 1 && spec.width > 1) ? spec.width - 1 : spec.width;
+        edited = scalars > 1 ? 1 + static_cast<unsigned int>(pick.next() % (scalars - 1)) : 0;
+    }
+    if (mutation == Linus::jsondiff::SyntheticSpec::RENAME)
+    {
+        renamed = spec.width > 1 ? 1 + static_cast<unsigned int>(pick.next() % (spec.width - 1)) : 0;
+    }
+    write_object(writer, random, spec.depth, spec.width, edited, renamed);
+}
+
+//member 0 is an "id" (a plain int, Int64 values all score as equal), the others cycle through bool, int, string, double
+//and a short array of ints; below the last level the last member holds an array of one to three nested objects. edit is
+//the member whose value changes and rename the member whose key changes, width for none
+void Linus::jsondiff::SyntheticPair::write_object(rapidjson::Writer<rapidjson::StringBuffer>& writer, Linus::jsondiff::SyntheticRandom& random, unsigned int depth, unsigned int width, unsigned int edit, unsigned int rename)
+{
+    writer.StartObject();
+    for (unsigned int m = 0; m < width; ++m)
+    {
+        std::string name = m == 0 ? "id" : "f" + std::to_string(m);
+        if (m == rename)
+        {
+            name += "_renamed";
+        }
+        writer.Key(name.c_str(), static_cast<rapidjson::SizeType>(name.size()));
+        if (m > 0 && m + 1 == width && depth > 1)
+        {
+            unsigned int count = 1 + static_cast<unsigned int>(random.next() % 3);
+            writer.StartArray();
+            for (unsigned int c = 0; c < count; ++c)
+            {
+                write_object(writer, random, depth - 1, width, width, width);
+            }
+            writer.EndArray();
+            continue;
+        }
+        std::uint64_t value = random.next();
+        if (m == edit)
+        {
+            value ^= 1;
+        }
+        if (m == 0)
+        {
+            writer.Int(static_cast<int>(value % 1000000000));
+            continue;
+        }
+        switch (m % 5)
+        {
+            case 0:
+                writer.Bool(value & 1);
+                break;
+            case 1:
+                writer.Int(static_cast<int>(value % 1000000));
+                break;
+            case 2:
+            {
+                std::string text = "v" + std::to_string(value % 100000);
+                writer.String(text.c_str(), static_cast<rapidjson::SizeType>(text.size()));
+                break;
+            }
+            case 3:
+                writer.Double((value % 100000) / 100.0);
+                break;
+            default:
+            {
+                //the first tag takes the low bits, so an edit changes it and leaves the count alone
+                unsigned int count = 2 + static_cast<unsigned int>((value >> 40) % 4);
+                writer.StartArray();
+                for (unsigned int t = 0; t < count; ++t)
+                {
+                    writer.Int(static_cast<int>((value >> (8 * t)) % 100));
+                }
+                writer.EndArray();
+                break;
+            }
+        }
+    }
+    writer.EndObject();
+}
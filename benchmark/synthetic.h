@@ -0,0 +1,47 @@
+#include "document.h"
+
+namespace Linus
+{
+    namespace jsondiff
+    {
+        //shape of a generated pair: a top level array of size elements, each an object of width members nested depth levels,
+        //or a plain integer when depth is 0; change_rate of the elements get one of the enabled mutations on the right
+        class SyntheticSpec
+        {
+            public:
+                static const unsigned int EDIT = 1;
+                static const unsigned int REMOVE = 2;
+                static const unsigned int INSERT = 4;
+                static const unsigned int MOVE = 8;
+                static const unsigned int RENAME = 16;
+                static const unsigned int ALL = 31;
+                unsigned int size;
+                unsigned int depth;
+                unsigned int width;
+                double change_rate;
+                std::uint64_t seed;
+                unsigned int mutations;
+                SyntheticSpec(unsigned int size_input, unsigned int depth_input, unsigned int width_input, double change_rate_input, std::uint64_t seed_input);
+                void fit_bytes(std::size_t bytes);
+                bool set_mutations(const std::string& list);
+        };
+        class SyntheticRandom
+        {
+            public:
+                std::uint64_t state;
+                SyntheticRandom(std::uint64_t seed);
+                std::uint64_t next();
+                double uniform();
+        };
+        //the same spec and seed give the same text on every platform
+        class SyntheticPair
+        {
+            public:
+                std::string left;
+                std::string right;
+                SyntheticPair(const Linus::jsondiff::SyntheticSpec& spec);
+                void write_element(rapidjson::Writer<rapidjson::StringBuffer>& writer, const Linus::jsondiff::SyntheticSpec& spec, std::uint64_t seed, unsigned int mutation);
+                void write_object(rapidjson::Writer<rapidjson::StringBuffer>& writer, Linus::jsondiff::SyntheticRandom& random, unsigned int depth, unsigned int width, unsigned int edit, unsigned int rename);
+        };
+    }
+}
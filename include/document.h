@@ -1,10 +1,18 @@
 #include <rapidjson/document.h>
 #include <rapidjson/pointer.h>
 #include <rapidjson/writer.h>
+#include <rapidjson/reader.h>
+#include <rapidjson/memorystream.h>
+#include <rapidjson/error/en.h>
 #include <rapidjson/stringbuffer.h>
 #include <oneTBB/include/tbb/concurrent_queue.h>
+#include <oneTBB/include/tbb/parallel_for.h>
+#include <oneTBB/include/tbb/task_arena.h>
+#include <oneTBB/include/tbb/task_group.h>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <memory>
 #include <iostream>
 #include <string>
@@ -15,11 +23,17 @@
 #include <regex>
 #include <algorithm>
 #include <thread>
+#include <future>
 #include <mutex>
+#include <shared_mutex>
+#include <atomic>
 #include <queue>
 #include <chrono>
 #include <cmath>
 #include <cctype>
+#include <cstdint>
+#include <limits>
+#include <functional>
 using namespace rapidjson;
 using namespace std;
 
@@ -29,6 +43,8 @@ const std::string EVENT_OBJECT_REMOVE = "object:remove";
 const std::string EVENT_OBJECT_ADD = "object:add";
 const std::string EVENT_ARRAY_REMOVE = "array:remove";
 const std::string EVENT_ARRAY_ADD = "array:add";
+const std::string EVENT_ARRAY_HASH_MATCH = "array:hash_match";
+const std::string EVENT_ARRAY_INDEX_MATCH = "array:index_match";
 const std::string EVENT_VALUE_CHANGE = "value_changes";
 
 namespace Linus
@@ -37,50 +53,306 @@ namespace Linus
     {
         std::string ValueToString(const rapidjson::Value& value);
         std::vector<std::string> KeysFromObject(const rapidjson::Value& value);
+        struct SubtreeDigest
+        {
+            std::uint64_t hash;
+            unsigned int count;
+        };
+        class SimilarityCache
+        {
+            public:
+                struct Entry
+                {
+                    const rapidjson::Value* left;
+                    const rapidjson::Value* right;
+                    double score;
+                };
+                static const unsigned int BUCKET_SIZE = 4;
+                static const unsigned int LOCK_STRIPES = 1024;
+                std::vector<Entry> slots;
+                std::vector<unsigned char> victims;
+                std::unique_ptr<std::mutex[]> locks;
+                unsigned int bucket_mask;
+                std::atomic<std::uint64_t> hit_count;
+                std::atomic<std::uint64_t> miss_count;
+                std::atomic<std::uint64_t> eviction_count;
+                SimilarityCache(unsigned int capacity);
+                void resize(unsigned int capacity);
+                void clear();
+                unsigned int bucket_of(const rapidjson::Value* left, const rapidjson::Value* right);
+                bool find(const rapidjson::Value* left, const rapidjson::Value* right, double& score);
+                void insert(const rapidjson::Value* left, const rapidjson::Value* right, double score);
+                std::uint64_t hits();
+                std::uint64_t misses();
+                std::uint64_t evictions();
+        };
+        class JsonSource
+        {
+            public:
+                rapidjson::Document document;
+                char* data;
+                std::size_t size;
+                std::size_t mapped;
+                std::vector<char> copy;
+                double parse_time;
+                JsonSource();
+                ~JsonSource();
+                JsonSource(const Linus::jsondiff::JsonSource&) = delete;
+                Linus::jsondiff::JsonSource& operator=(const Linus::jsondiff::JsonSource&) = delete;
+                void open(const std::string& json, bool populate, bool huge_pages);
+                void load(const std::string& json, bool populate, bool huge_pages);
+                void map_file(const std::string& path, bool populate, bool huge_pages);
+                void release();
+        };
+        //hardware counters of this process and the threads it starts afterwards, read through perf_event_open;
+        //a counter the kernel refuses (or any counter off Linux) keeps fd -1 and is left out of the stats
+        class PerfCounters
+        {
+            public:
+                static const int COUNT = 4;
+                static const char* const NAMES[COUNT];
+                int fds[COUNT];
+                PerfCounters();
+                ~PerfCounters();
+                PerfCounters(const Linus::jsondiff::PerfCounters&) = delete;
+                Linus::jsondiff::PerfCounters& operator=(const Linus::jsondiff::PerfCounters&) = delete;
+                bool read(int index, std::uint64_t& value);
+        };
+        //named counters, peaks and timers, off unless enabled is set; every thread adds into its own instance, which
+        //to_json sums over, so an event costs a single test of enabled when stats are off and no atomics when they are on
+        class Stats
+        {
+            public:
+                enum Counter { NODES_VISITED, DRILL_CALLS, DP_CELLS, SCRATCH_BYTES, RECORDS_EMITTED, ARRAYS_DOWNGRADED, CACHE_HITS, CACHE_MISSES, CACHE_EVICTIONS, COUNTER_COUNT };
+                enum Peak { PEAK_DP_BYTES, PEAK_COUNT };
+                enum Timer { PARSE, PARSE_LEFT, PARSE_RIGHT, DIFF, WAVEFRONT_FILL, LCS_TRACEBACK, TIMER_COUNT };
+                static const char* const COUNTER_NAMES[COUNTER_COUNT];
+                static const char* const PEAK_NAMES[PEAK_COUNT];
+                static const char* const TIMER_NAMES[TIMER_COUNT];
+                static bool enabled;
+                static std::mutex registry_mutex;
+                static std::vector<std::unique_ptr<Linus::jsondiff::Stats>> registry;
+                std::uint64_t counters[COUNTER_COUNT];
+                std::uint64_t peaks[PEAK_COUNT];
+                double timers[TIMER_COUNT];
+                Stats();
+                static Linus::jsondiff::Stats& local();
+                static void count(Counter counter, std::uint64_t amount) { if (enabled) local().counters[counter] += amount; }
+                static void peak(Peak peak, std::uint64_t value) { if (enabled) local().peaks[peak] = std::max(local().peaks[peak], value); }
+                static void add_time(Timer timer, double seconds) { if (enabled) local().timers[timer] += seconds; }
+                static std::string to_json(Linus::jsondiff::PerfCounters* hardware);
+        };
+        class StatTimer
+        {
+            public:
+                Linus::jsondiff::Stats::Timer timer;
+                bool running;
+                std::chrono::steady_clock::time_point start;
+                StatTimer(Linus::jsondiff::Stats::Timer timer_input);
+                ~StatTimer();
+        };
+        //per-thread bump allocator behind the similarity path; Scratch releases frames in LIFO order, so when a top-level
+        //comparison returns the arena is empty again and keeps its blocks for the next one
+        class ScratchArena
+        {
+            public:
+                static const std::size_t BLOCK_SIZE = 1 << 20;
+                std::vector<std::unique_ptr<char[]>> blocks;
+                std::vector<std::size_t> sizes;
+                std::size_t block;
+                std::size_t top;
+                ScratchArena();
+                static Linus::jsondiff::ScratchArena& local();
+                void* allocate(std::size_t bytes);
+        };
+        template <typename T>
+        class Scratch
+        {
+            public:
+                Linus::jsondiff::ScratchArena& arena;
+                std::size_t block;
+                std::size_t top;
+                T* data;
+                std::size_t length;
+                Scratch(std::size_t count, const T& value) : arena(Linus::jsondiff::ScratchArena::local()), block(arena.block), top(arena.top), data(static_cast<T*>(arena.allocate(count * sizeof(T)))), length(count)
+                {
+                    std::fill(data, data + length, value);
+                }
+                ~Scratch()
+                {
+                    arena.block = block;
+                    arena.top = top;
+                }
+                Scratch(const Linus::jsondiff::Scratch<T>&) = delete;
+                Linus::jsondiff::Scratch<T>& operator=(const Linus::jsondiff::Scratch<T>&) = delete;
+                T& operator[](std::size_t index) { return data[index]; }
+                const T& operator[](std::size_t index) const { return data[index]; }
+                T* begin() { return data; }
+                T* end() { return data + length; }
+                std::size_t size() const { return length; }
+                void swap(Linus::jsondiff::Scratch<T>& other) { std::swap(data, other.data); std::swap(length, other.length); }
+        };
+        class DirectionPlane
+        {
+            public:
+                static const unsigned char LEFT = 0;
+                static const unsigned char UP = 1;
+                static const unsigned char DIAGONAL = 2;
+                std::size_t stride;
+                Linus::jsondiff::Scratch<std::uint8_t> bits;
+                DirectionPlane(std::size_t rows, std::size_t columns);
+                void set(std::size_t row, std::size_t column, unsigned char direction);
+                unsigned char get(std::size_t row, std::size_t column) const;
+        };
+        class DiffSink
+        {
+            public:
+                static const std::size_t DEFAULT_CAPACITY = 1 << 16;
+                static const long long FLUSH_INTERVAL_MS = 10;
+                std::ostream* stream;
+                std::function<void(const std::string&)> callback;
+                std::string pending;
+                std::size_t capacity;
+                std::uint64_t count;
+                std::chrono::steady_clock::time_point last_flush;
+                DiffSink(std::ostream& output, std::size_t buffer_size = DEFAULT_CAPACITY);
+                DiffSink(std::function<void(const std::string&)> output);
+                ~DiffSink();
+                void write(const std::string& line);
+                void flush();
+        };
+        class DiffBuffer
+        {
+            public:
+                std::vector<std::pair<std::string, std::string>> entries;
+                std::vector<std::pair<std::size_t, std::unique_ptr<Linus::jsondiff::DiffBuffer>>> branches;
+                std::atomic<bool> done;
+                DiffBuffer();
+                void push(const std::string& event, const std::string& info);
+                Linus::jsondiff::DiffBuffer* branch();
+                void merge(std::map<std::string, std::vector<std::string>>& records);
+                bool flush(Linus::jsondiff::DiffSink& sink);
+                void clear();
+        };
+        class PathNode
+        {
+            public:
+                const Linus::jsondiff::PathNode* parent;
+                const char* key;
+                unsigned int length;
+                unsigned int index;
+
+                PathNode(const Linus::jsondiff::PathNode* parent_node, unsigned int index_input);
+                PathNode(const Linus::jsondiff::PathNode* parent_node, const std::string& key_input);
+                PathNode(const Linus::jsondiff::PathNode* parent_node, const rapidjson::Value& name);
+        };
+        std::string PathToString(const Linus::jsondiff::PathNode* path);
         class TreeLevel
         {
             public:
-                static const std::string empty_string;
                 const rapidjson::Value& left;
                 const rapidjson::Value& right;
-                const std::string& left_path;
-                const std::string& right_path;
-                const std::string& up;
+                const Linus::jsondiff::PathNode* left_path;
+                const Linus::jsondiff::PathNode* right_path;
+                const Linus::jsondiff::PathNode* up;
 
                 TreeLevel(const rapidjson::Value& left_input, const rapidjson::Value& right_input,\
-                 const std::string& path_left, const std::string& path_right, const std::string& up_level);
+                 const Linus::jsondiff::PathNode* path_left, const Linus::jsondiff::PathNode* path_right, const Linus::jsondiff::PathNode* up_level);
                 TreeLevel(const rapidjson::Value& left_input, const rapidjson::Value& right_input);
 
                 int get_type();
                 std::string to_info();
+                std::string to_json(const std::string& event);
+                std::string to_path_info();
+                std::string to_path_json(const std::string& event);
                 std::string get_key();
         };
         class JsonDiffer
         {
             public:
                 const double SIMILARITY_THRESHOLD;
+                static const std::uint64_t PARALLEL_CELLS = 4096;
+                static const std::uint64_t HIRSCHBERG_CELLS = 4096;
+                static const unsigned int TASK_CUTOFF = 1024;
+                static const unsigned int TASK_FANOUT = 64;
+                static const unsigned int KEY_INDEX_MIN = 16;
+                static const int INITIAL_BAND = 8;
+                static constexpr double PRUNE_SLACK = 1e-9;
+                static const unsigned int LSH_BUCKET_MAX = 32;
+                static const int FULL_MATCH = 0;
+                static const int HASH_MATCH = 1;
+                static const int INDEX_MATCH = 2;
+                static const std::uint64_t OTHER_HASH = 0x9e3779b97f4a7c15ULL;
+                static constexpr double WORK_PER_SECOND = 1e7;
                 const rapidjson::Value& left;
                 const rapidjson::Value& right;
-                std::map<std::string, double> cache;
+                Linus::jsondiff::SimilarityCache cache;
                 std::map<std::string, std::vector<std::string>> records;
                 bool advanced_mode;
                 bool hirscheburg;
+                bool myers;
+                std::vector<std::string> match_key;
+                bool auto_match_key;
+                int band;
+                int max_band;
+                unsigned int lsh_bands;
+                unsigned int lsh_rows;
+                std::uint64_t work_budget;
+                std::atomic<std::uint64_t> work_spent;
+                std::chrono::steady_clock::time_point deadline;
                 int num_thread;
-                std::mutex cache_mutex;
+                tbb::task_arena arena;
+                Linus::jsondiff::DiffBuffer buffer;
+                Linus::jsondiff::DiffSink* sink;
+                std::unordered_map<const rapidjson::Value*, Linus::jsondiff::SubtreeDigest> digests;
+                std::unordered_map<const rapidjson::Value*, std::vector<const rapidjson::Value::Member*>> key_indexes;
+                std::shared_mutex key_index_mutex;
                 JsonDiffer(const rapidjson::Value& left_input, const rapidjson::Value& right_input, bool advanced, bool hirscheburg, double similarity_threshold, int thread_count);
                 void report(std::string event, Linus::jsondiff::TreeLevel level);
+                void report_paths(std::string event, Linus::jsondiff::TreeLevel level);
+                void emit(const std::string& event, std::string info);
                 std::map<std::string, std::vector<std::string>> to_info();
                 double compare_array(Linus::jsondiff::TreeLevel level, bool drill);
                 double compare_array_fast(Linus::jsondiff::TreeLevel level, bool drill);
                 int get_type(const rapidjson::Value& input);
-                void parallel_diff_level(std::queue<std::pair<unsigned int, unsigned int>>& work_queue, std::vector<std::vector<double>>& dp, Linus::jsondiff::TreeLevel& level, std::mutex& work_queue_mutex, std::mutex& dp_mutex);
-                std::map<unsigned int, unsigned int> parallel_LCS(Linus::jsondiff::TreeLevel level);
-                std::map<unsigned int, unsigned int> LCS(Linus::jsondiff::TreeLevel level, bool drill);
-                double drill_LCS(const rapidjson::Value& left, const rapidjson::Value& right);
-                double drill_obj(const rapidjson::Value& left, const rapidjson::Value& right);
-                std::vector<double> NWScore(bool reverse, Linus::jsondiff::TreeLevel level, bool drill, std::vector<int>& type_left, unsigned int sleft, unsigned int eleft, std::vector<int>& type_right, unsigned int sright, unsigned int eright);
-                std::map<unsigned int, unsigned int> Hirschberg(Linus::jsondiff::TreeLevel level, bool drill, std::vector<int>& type_left, unsigned int sleft, unsigned int eleft, std::vector<int>& type_right, unsigned int sright, unsigned int eright);
+                Linus::jsondiff::SubtreeDigest build_digest(const rapidjson::Value& input);
+                void drop_digest(const rapidjson::Value& input);
+                const rapidjson::Value::Member* const* key_index(const rapidjson::Value& object, Linus::jsondiff::Scratch<const rapidjson::Value::Member*>& scratch);
+                std::uint64_t get_hash(const rapidjson::Value& input);
+                std::uint64_t element_hash(const rapidjson::Value& input, int type);
+                unsigned int get_count(const rapidjson::Value& input);
+                bool spawn_task(const rapidjson::Value& left, const rapidjson::Value& right);
+                void fork_task(tbb::task_group& group, std::function<void()> task);
+                void join_tasks(tbb::task_group& group);
+                int gap_match(Linus::jsondiff::TreeLevel& level, std::uint64_t cells);
+                void pair_gaps(std::map<unsigned int, unsigned int>& pair_list, unsigned int sleft, unsigned int eleft, unsigned int sright, unsigned int eright);
+                bool out_of_time();
+                bool same_subtree(const rapidjson::Value& left, const rapidjson::Value& right);
+                double pair_score(const rapidjson::Value& left, const rapidjson::Value& right, int type_left, int type_right, std::uint64_t hash_left, std::uint64_t hash_right);
+                void fill_tile(Linus::jsondiff::TreeLevel& level, std::vector<int>& type_left, std::vector<std::uint64_t>& hash_left, unsigned int sleft, std::vector<int>& type_right, std::vector<std::uint64_t>& hash_right, unsigned int sright, std::vector<double>& bottom, std::vector<double>& above, std::vector<double>& right_edge, std::vector<double>& left_edge, Linus::jsondiff::DirectionPlane& moves, unsigned int row_begin, unsigned int row_end, unsigned int col_begin, unsigned int col_end);
+                std::map<unsigned int, unsigned int> parallel_LCS(Linus::jsondiff::TreeLevel level, std::vector<int>& type_left, std::vector<std::uint64_t>& hash_left, unsigned int sleft, unsigned int eleft, std::vector<int>& type_right, std::vector<std::uint64_t>& hash_right, unsigned int sright, unsigned int eright);
+                bool scalar_run(const rapidjson::Value& array, const int* type, unsigned int start, unsigned int end);
+                unsigned int bit_LCS(const std::uint64_t* hash_left, unsigned int sleft, unsigned int eleft, const std::uint64_t* hash_right, unsigned int sright, unsigned int eright, std::map<unsigned int, unsigned int>* pair_list);
+                std::map<unsigned int, unsigned int> LCS(Linus::jsondiff::TreeLevel level);
+                std::map<unsigned int, unsigned int> LCS(Linus::jsondiff::TreeLevel level, std::vector<int>& type_left, std::vector<std::uint64_t>& hash_left, unsigned int sleft, unsigned int eleft, std::vector<int>& type_right, std::vector<std::uint64_t>& hash_right, unsigned int sright, unsigned int eright);
+                double drill_LCS(const rapidjson::Value& left, const rapidjson::Value& right, double cutoff);
+                double drill_obj(const rapidjson::Value& left, const rapidjson::Value& right, double cutoff);
+                void NWScore(bool reverse, Linus::jsondiff::TreeLevel level, bool drill, std::vector<int>& type_left, std::vector<std::uint64_t>& hash_left, unsigned int sleft, unsigned int eleft, std::vector<int>& type_right, std::vector<std::uint64_t>& hash_right, unsigned int sright, unsigned int eright, double* score);
+                std::map<unsigned int, unsigned int> Hirschberg(Linus::jsondiff::TreeLevel level, bool drill, std::vector<int>& type_left, std::vector<std::uint64_t>& hash_left, unsigned int sleft, unsigned int eleft, std::vector<int>& type_right, std::vector<std::uint64_t>& hash_right, unsigned int sright, unsigned int eright);
+                void Hirschberg_split(Linus::jsondiff::TreeLevel& level, bool drill, std::vector<int>& type_left, std::vector<std::uint64_t>& hash_left, unsigned int sleft, unsigned int eleft, std::vector<int>& type_right, std::vector<std::uint64_t>& hash_right, unsigned int sright, unsigned int eright, std::vector<int>& matches, unsigned int first);
                 std::map<unsigned int, unsigned int> Hirschberg_starter(Linus::jsondiff::TreeLevel level);
+                int anchor_gap(Linus::jsondiff::TreeLevel level, std::vector<int>& type_left, std::vector<std::uint64_t>& hash_left, unsigned int sleft, unsigned int eleft, std::vector<int>& type_right, std::vector<std::uint64_t>& hash_right, unsigned int sright, unsigned int eright, std::map<unsigned int, unsigned int>& pair_list);
+                std::map<unsigned int, unsigned int> banded_LCS(Linus::jsondiff::TreeLevel& level, std::vector<int>& type_left, std::vector<std::uint64_t>& hash_left, unsigned int sleft, unsigned int eleft, std::vector<int>& type_right, std::vector<std::uint64_t>& hash_right, unsigned int sright, unsigned int eright);
+                std::vector<std::uint64_t> minhash(const rapidjson::Value& input, std::uint64_t hash, unsigned int length);
+                std::map<unsigned int, unsigned int> minhash_LCS(Linus::jsondiff::TreeLevel& level, std::vector<int>& type_left, std::vector<std::uint64_t>& hash_left, unsigned int sleft, unsigned int eleft, std::vector<int>& type_right, std::vector<std::uint64_t>& hash_right, unsigned int sright, unsigned int eright);
+                std::map<unsigned int, unsigned int> anchored_LCS(Linus::jsondiff::TreeLevel level, int& match);
+                void set_match_key(const std::string& path);
+                bool element_key(const rapidjson::Value& element, const std::vector<std::string>& path, std::uint64_t& key);
+                bool detect_key(Linus::jsondiff::TreeLevel& level, std::vector<std::string>& path);
+                std::map<unsigned int, unsigned int> key_join(Linus::jsondiff::TreeLevel level, int& match);
+                std::map<unsigned int, unsigned int> index_LCS(Linus::jsondiff::TreeLevel& level, std::vector<unsigned int>& left_index, std::vector<unsigned int>& right_index);
+                bool Myers(std::vector<std::uint64_t>& hash_left, unsigned int sleft, unsigned int eleft, std::vector<std::uint64_t>& hash_right, unsigned int sright, unsigned int eright, std::map<unsigned int, unsigned int>& pair_list);
+                void Myers_linear(std::vector<std::uint64_t>& hash_left, unsigned int sleft, unsigned int eleft, std::vector<std::uint64_t>& hash_right, unsigned int sright, unsigned int eright, std::map<unsigned int, unsigned int>& pair_list);
                 double compare_array_advanced(Linus::jsondiff::TreeLevel level, bool drill);
                 double compare_object(Linus::jsondiff::TreeLevel level, bool drill);
                 double compare_Int(Linus::jsondiff::TreeLevel level, bool drill);
@@ -91,6 +363,59 @@ namespace Linus
                 double diff_level(Linus::jsondiff::TreeLevel level, bool drill);
                 bool diff();
         };
+        class SaxToken
+        {
+            public:
+                enum Kind { NONE, SCALAR, KEY, START_OBJECT, END_OBJECT, START_ARRAY, END_ARRAY };
+                Kind kind;
+                int scalar;
+                bool boolean;
+                std::int64_t integer;
+                std::uint64_t unsigned_integer;
+                double number;
+                std::string text;
+                SaxToken();
+                bool Null();
+                bool Bool(bool b);
+                bool Int(int i);
+                bool Uint(unsigned u);
+                bool Int64(std::int64_t i);
+                bool Uint64(std::uint64_t u);
+                bool Double(double d);
+                bool RawNumber(const char* str, rapidjson::SizeType length, bool copy);
+                bool String(const char* str, rapidjson::SizeType length, bool copy);
+                bool StartObject();
+                bool Key(const char* str, rapidjson::SizeType length, bool copy);
+                bool EndObject(rapidjson::SizeType member_count);
+                bool StartArray();
+                bool EndArray(rapidjson::SizeType element_count);
+                void to_value(rapidjson::Value& value);
+                void to_value(rapidjson::Value& value, rapidjson::Document::AllocatorType& allocator);
+        };
+        class StreamSide
+        {
+            public:
+                rapidjson::Reader reader;
+                rapidjson::MemoryStream stream;
+                Linus::jsondiff::SaxToken token;
+                StreamSide(const char* data, std::size_t size);
+                bool next();
+        };
+        class StreamDiffer
+        {
+            public:
+                Linus::jsondiff::JsonDiffer& differ;
+                Linus::jsondiff::StreamSide left;
+                Linus::jsondiff::StreamSide right;
+                bool same;
+                StreamDiffer(Linus::jsondiff::JsonDiffer& differ_input, const char* left_data, std::size_t left_size, const char* right_data, std::size_t right_size);
+                bool diff();
+                void diff_value(const Linus::jsondiff::PathNode* left_path, const Linus::jsondiff::PathNode* right_path, const Linus::jsondiff::PathNode* up);
+                void diff_object(const Linus::jsondiff::PathNode* left_path, const Linus::jsondiff::PathNode* right_path);
+                void diff_array(const Linus::jsondiff::PathNode* left_path, const Linus::jsondiff::PathNode* right_path);
+                void compare(const rapidjson::Value& left_value, const rapidjson::Value& right_value, const Linus::jsondiff::PathNode* left_path, const Linus::jsondiff::PathNode* right_path, const Linus::jsondiff::PathNode* up);
+                void materialize(Linus::jsondiff::StreamSide& side, rapidjson::Value& value, rapidjson::Document::AllocatorType& allocator);
+        };
         class BottomUpLCS
         {
             public:
@@ -1,35 +1,21 @@
 #include "document.h"
 
-rapidjson::Document loadjson(std::string json)
+//status lines move to stderr when the differences are streamed to stdout
+std::ostream* log_stream = &std::cout;
+
+//left and right are mapped and parsed in place on two threads; "parse" in -stats is the wall time of both, "parse_left"
+//and "parse_right" the time each side took on its own thread
+void loadjson(Linus::jsondiff::JsonSource& left_source, Linus::jsondiff::JsonSource& right_source, std::string left, std::string right, bool populate, bool huge_pages)
 {
-    rapidjson::Document document;
-    if (json[0] == '{' or json[0] == '[')
-    {
-        auto start = std::chrono::high_resolution_clock::now();
-        document.Parse(json.c_str());
-        auto finish = std::chrono::high_resolution_clock::now();
-        std::chrono::duration<double> elapsed = finish - start;
-        std::cout << "Parsing time: " << elapsed.count() << " s\n";
-    }
-    else
+    Linus::jsondiff::StatTimer timer(Linus::jsondiff::Stats::PARSE);
+    auto left_task = std::async(std::launch::async, [&]()
     {
-        std::ifstream file(json);
-        if (!file.is_open())
-        {
-            std::cerr << "Cannot open file: " << json << std::endl;
-            throw std::runtime_error("File open failed");
-        }
-        std::stringstream buffer;
-        buffer << file.rdbuf();
-        file.close();
-        auto start = std::chrono::high_resolution_clock::now();
-        document.Parse(buffer.str().c_str());
-        auto finish = std::chrono::high_resolution_clock::now();
-        std::chrono::duration<double> elapsed = finish - start;
-        std::cout << "Parsing time: " << elapsed.count() << " s\n";
-        buffer.clear();
-    }
-    return document;
+        left_source.load(left, populate, huge_pages);
+    });
+    right_source.load(right, populate, huge_pages);
+    left_task.get();
+    Linus::jsondiff::Stats::add_time(Linus::jsondiff::Stats::PARSE_LEFT, left_source.parse_time);
+    Linus::jsondiff::Stats::add_time(Linus::jsondiff::Stats::PARSE_RIGHT, right_source.parse_time);
 }
 
 void PrintRecords(std::map<std::string, std::vector<std::string>> records)
@@ -45,22 +31,78 @@ void PrintRecords(std::map<std::string, std::vector<std::string>> records)
     std::cout << result.str() << std::endl;
 }
 
-void run(std::string left, std::string right, bool advanced_mode, double similarity_threshold, int thread_count)
+void run(std::string left, std::string right, bool advanced_mode, bool hirscheburg, bool myers, double similarity_threshold, int thread_count, std::string output, bool populate, bool huge_pages, bool stream, std::string match_key, int band, int max_band, unsigned int lsh_bands, unsigned int lsh_rows, double deadline, std::uint64_t work_budget)
 {
+    //the deadline counts from the start of the run, so parsing spends from it too
+    auto begin = std::chrono::steady_clock::now();
     try 
     {
 
-        rapidjson::Document left_json_ = loadjson(left);
-        rapidjson::Document right_json_ = loadjson(right);
-        const rapidjson::Value& left_json = left_json_;
+        Linus::jsondiff::JsonSource left_source, right_source;
+        if (stream)
+        {
+            left_source.open(left, populate, huge_pages);
+            right_source.open(right, populate, huge_pages);
+        }
+        else
+        {
+            loadjson(left_source, right_source, left, right, populate, huge_pages);
+        }
+        const rapidjson::Value& left_json = left_source.document;
         //cout << Linus::jsondiff::ValueToString(left_json) << endl;
-        const rapidjson::Value& right_json = right_json_;
+        const rapidjson::Value& right_json = right_source.document;
         //cout << Linus::jsondiff::ValueToString(right_json) << endl;
-        Linus::jsondiff::JsonDiffer jsondiffer(left_json, right_json, advanced_mode, similarity_threshold, thread_count);
-        bool same = jsondiffer.diff();
+        Linus::jsondiff::JsonDiffer jsondiffer(left_json, right_json, advanced_mode, hirscheburg, similarity_threshold, thread_count);
+        jsondiffer.myers = myers;
+        if (!match_key.empty())
+        {
+            jsondiffer.set_match_key(match_key);
+        }
+        jsondiffer.band = band;
+        jsondiffer.max_band = max_band;
+        jsondiffer.lsh_bands = lsh_bands;
+        jsondiffer.lsh_rows = lsh_rows;
+        jsondiffer.work_budget = work_budget;
+        if (deadline > 0)
+        {
+            jsondiffer.deadline = begin + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(deadline));
+        }
+        std::ofstream file;
+        std::unique_ptr<Linus::jsondiff::DiffSink> sink;
+        if (output == "-")
+        {
+            sink.reset(new Linus::jsondiff::DiffSink(std::cout));
+        }
+        else if (!output.empty())
+        {
+            file.open(output, std::ios::out | std::ios::binary);
+            if (!file.is_open())
+            {
+                std::cerr << "Cannot open file: " << output << std::endl;
+                throw std::runtime_error("File open failed");
+            }
+            sink.reset(new Linus::jsondiff::DiffSink(file));
+        }
+        jsondiffer.sink = sink.get();
+        bool same;
+        if (stream)
+        {
+            Linus::jsondiff::StreamDiffer streamer(jsondiffer, left_source.data, left_source.size, right_source.data, right_source.size);
+            same = streamer.diff();
+        }
+        else
+        {
+            same = jsondiffer.diff();
+        }
         std::string result = same ? "Same" : "Different";
-        std::cout << result << std::endl;
-        PrintRecords(jsondiffer.records);
+        *log_stream << result << std::endl;
+        if (sink == nullptr)
+        {
+            PrintRecords(jsondiffer.records);
+        }
+        Linus::jsondiff::Stats::count(Linus::jsondiff::Stats::CACHE_HITS, jsondiffer.cache.hits());
+        Linus::jsondiff::Stats::count(Linus::jsondiff::Stats::CACHE_MISSES, jsondiffer.cache.misses());
+        Linus::jsondiff::Stats::count(Linus::jsondiff::Stats::CACHE_EVICTIONS, jsondiffer.cache.evictions());
     }
     catch (const std::exception& e) 
     {
@@ -68,14 +110,29 @@ void run(std::string left, std::string right, bool advanced_mode, double similar
     }
 }
 
-/*int main(int argc, char * argv[])
+int main(int argc, char * argv[])
 {
     auto start = std::chrono::high_resolution_clock::now();
     
     std::string left, right;
     bool advanced_mode = false;
+    bool hirscheburg = false;
+    bool myers = false;
     double similarity_threshold = 0.5;
     int thread_count = 1;
+    std::string output;
+    bool populate = false;
+    bool huge_pages = false;
+    bool stream = false;
+    std::string match_key;
+    int band = 0;
+    int max_band = 4096;
+    unsigned int lsh_bands = 0;
+    unsigned int lsh_rows = 4;
+    double deadline = 0;
+    std::uint64_t work_budget = 0;
+    std::string stats;
+    bool perf = false;
     for (int i = 1; i < argc; ++i)
     {
         std::string arg = argv[i];
@@ -89,10 +146,50 @@ void run(std::string left, std::string right, bool advanced_mode, double similar
             right = argv[++i];
             //cout << right << endl;
         }
+        if ((arg == "-output" || arg == "-O") && i + 1 < argc)
+        {
+            output = argv[++i];
+            if (output == "-")
+            {
+                log_stream = &std::cerr;
+            }
+        }
+        if (arg == "-populate" || arg == "-P")
+        {
+            populate = true;
+        }
+        if (arg == "-huge_pages")
+        {
+            huge_pages = true;
+        }
+        if (arg == "-stream")
+        {
+            stream = true;
+        }
+        if (arg == "-stats" && i + 1 < argc)
+        {
+            stats = argv[++i];
+        }
+        if (arg == "-perf")
+        {
+            perf = true;
+        }
         if (arg == "-advanced_mode" || arg == "-A")
         {
             advanced_mode = true;
         }
+        if (arg == "-hirscheberg" || arg == "-H")
+        {
+            hirscheburg = true;
+        }
+        if ((arg == "-match_key" || arg == "-K") && i + 1 < argc)
+        {
+            match_key = argv[++i];
+        }
+        if (arg == "-myers" || arg == "-M")
+        {
+            myers = true;
+        }
         if ((arg == "-similarity_threshold" || arg == "-S") && i + 1 < argc)
         {
             try 
@@ -108,6 +205,97 @@ void run(std::string left, std::string right, bool advanced_mode, double similar
                 std::cerr << "Similarity threshold out of range: " << argv[i] << std::endl;
             }
         }
+        if ((arg == "-band" || arg == "-B") && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            try 
+            {
+                band = value == "auto" ? -1 : std::max(1, std::stoi(value));
+            } 
+            catch (const std::invalid_argument& e) 
+            {
+                std::cerr << "Invalid band: " << value << std::endl;
+            }
+            catch (const std::out_of_range& e)
+            {
+                std::cerr << "Band out of range: " << value << std::endl;
+            }
+        }
+        if (arg == "-max_band" && i + 1 < argc)
+        {
+            try 
+            {
+                max_band = std::stoi(argv[++i]);
+            } 
+            catch (const std::invalid_argument& e) 
+            {
+                std::cerr << "Invalid max band: " << argv[i] << std::endl;
+            }
+            catch (const std::out_of_range& e)
+            {
+                std::cerr << "Max band out of range: " << argv[i] << std::endl;
+            }
+        }
+        if (arg == "-lsh" && i + 1 < argc)
+        {
+            try 
+            {
+                lsh_bands = std::stoul(argv[++i]);
+            } 
+            catch (const std::invalid_argument& e) 
+            {
+                std::cerr << "Invalid LSH band count: " << argv[i] << std::endl;
+            }
+            catch (const std::out_of_range& e)
+            {
+                std::cerr << "LSH band count out of range: " << argv[i] << std::endl;
+            }
+        }
+        if (arg == "-lsh_rows" && i + 1 < argc)
+        {
+            try 
+            {
+                lsh_rows = std::stoul(argv[++i]);
+            } 
+            catch (const std::invalid_argument& e) 
+            {
+                std::cerr << "Invalid LSH row count: " << argv[i] << std::endl;
+            }
+            catch (const std::out_of_range& e)
+            {
+                std::cerr << "LSH row count out of range: " << argv[i] << std::endl;
+            }
+        }
+        if (arg == "-deadline" && i + 1 < argc)
+        {
+            try 
+            {
+                deadline = std::stod(argv[++i]);
+            } 
+            catch (const std::invalid_argument& e) 
+            {
+                std::cerr << "Invalid deadline: " << argv[i] << std::endl;
+            }
+            catch (const std::out_of_range& e)
+            {
+                std::cerr << "Deadline out of range: " << argv[i] << std::endl;
+            }
+        }
+        if (arg == "-work_budget" && i + 1 < argc)
+        {
+            try 
+            {
+                work_budget = std::stoull(argv[++i]);
+            } 
+            catch (const std::invalid_argument& e) 
+            {
+                std::cerr << "Invalid work budget: " << argv[i] << std::endl;
+            }
+            catch (const std::out_of_range& e)
+            {
+                std::cerr << "Work budget out of range: " << argv[i] << std::endl;
+            }
+        }
         if ((arg == "-nthreads" || arg == "-N") && i + 1 < argc)
         {
             try 
@@ -124,20 +312,35 @@ void run(std::string left, std::string right, bool advanced_mode, double similar
             }
         }
     }
-    run(left, right, advanced_mode, similarity_threshold, thread_count);
+    if (stream && advanced_mode)
+    {
+        std::cerr << "Streaming diff only supports the fast mode, building documents instead" << std::endl;
+        stream = false;
+    }
+    //hardware counters are opened before the parser and TBB start their threads, so that those inherit them
+    Linus::jsondiff::Stats::enabled = !stats.empty();
+    std::unique_ptr<Linus::jsondiff::PerfCounters> hardware;
+    if (perf && !stats.empty())
+    {
+        hardware.reset(new Linus::jsondiff::PerfCounters());
+    }
+    run(left, right, advanced_mode, hirscheburg, myers, similarity_threshold, thread_count, output, populate, huge_pages, stream, match_key, band, max_band, lsh_bands, lsh_rows, deadline, work_budget);
     auto finish = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> elapsed = finish - start;
-    std::cout << "Total time: " << elapsed.count() << " s\n";
-    return 0;
-}*/
-
-
-int main ()
-{
-    //std::string json1 = "{\"number\":[1,2,3,4,5]}";
-    //std::string json2 = "{\"number\":[1,2,4,5]}";
-    std::string json1 = ".\\large-file-left.json";
-    std::string json2 = ".\\large-file-right.json";
-    run(json1, json2, true, 0.5, 1);
+    *log_stream << "Total time: " << elapsed.count() << " s\n";
+    if (stats == "-")
+    {
+        *log_stream << Linus::jsondiff::Stats::to_json(hardware.get()) << std::endl;
+    }
+    else if (!stats.empty())
+    {
+        std::ofstream file(stats, std::ios::out | std::ios::binary);
+        if (!file.is_open())
+        {
+            std::cerr << "Cannot open file: " << stats << std::endl;
+            return 1;
+        }
+        file << Linus::jsondiff::Stats::to_json(hardware.get()) << "\n";
+    }
     return 0;
 }
\ No newline at end of file
@@ -1,9 +1,23 @@
 #include "document.h"
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
 using namespace std;
 using namespace Linus::jsondiff;
 using namespace rapidjson;
 
-const std::string Linus::jsondiff::TreeLevel::empty_string = "";
+//buffer of the task running on this thread, tasks stolen inside a wait restore it when they finish
+static thread_local Linus::jsondiff::DiffBuffer* current_buffer = nullptr;
+//stands in for a missing counterpart when a side is absent
+static const rapidjson::Value empty_value("");
 
 std::string Linus::jsondiff::ValueToString(const rapidjson::Value& value)
 {
@@ -23,12 +37,50 @@ std::vector<std::string> Linus::jsondiff::KeysFromObject(const rapidjson::Value&
     return keys;
 }
 
-Linus::jsondiff::TreeLevel::TreeLevel(const rapidjson::Value& left_input, const rapidjson::Value& right_input, const std::string& path_left, const std::string& path_right, const std::string& up_level) : left(left_input), right(right_input), left_path(path_left), right_path(path_right), up(up_level)
+Linus::jsondiff::PathNode::PathNode(const Linus::jsondiff::PathNode* parent_node, unsigned int index_input) : parent(parent_node), key(nullptr), length(0), index(index_input)
+{
+
+}
+
+Linus::jsondiff::PathNode::PathNode(const Linus::jsondiff::PathNode* parent_node, const std::string& key_input) : parent(parent_node), key(key_input.data()), length(key_input.size()), index(0)
+{
+
+}
+
+Linus::jsondiff::PathNode::PathNode(const Linus::jsondiff::PathNode* parent_node, const rapidjson::Value& name) : parent(parent_node), key(name.GetString()), length(name.GetStringLength()), index(0)
+{
+
+}
+
+//paths are only rendered when a difference is reported, e.g. ["key"][3]
+std::string Linus::jsondiff::PathToString(const Linus::jsondiff::PathNode* path)
+{
+    std::vector<const Linus::jsondiff::PathNode*> chain;
+    for (; path != nullptr; path = path->parent)
+    {
+        chain.push_back(path);
+    }
+    std::string text;
+    for (auto iter = chain.rbegin(); iter != chain.rend(); ++iter)
+    {
+        if ((*iter)->key != nullptr)
+        {
+            text.append("[\"").append((*iter)->key, (*iter)->length).append("\"]");
+        }
+        else
+        {
+            text.append("[").append(std::to_string((*iter)->index)).append("]");
+        }
+    }
+    return text;
+}
+
+Linus::jsondiff::TreeLevel::TreeLevel(const rapidjson::Value& left_input, const rapidjson::Value& right_input, const Linus::jsondiff::PathNode* path_left, const Linus::jsondiff::PathNode* path_right, const Linus::jsondiff::PathNode* up_level) : left(left_input), right(right_input), left_path(path_left), right_path(path_right), up(up_level)
 {
     
 }
 
-Linus::jsondiff::TreeLevel::TreeLevel(const rapidjson::Value& left_input, const rapidjson::Value& right_input) : left(left_input), right(right_input), left_path(empty_string), right_path(empty_string), up(empty_string)
+Linus::jsondiff::TreeLevel::TreeLevel(const rapidjson::Value& left_input, const rapidjson::Value& right_input) : left(left_input), right(right_input), left_path(nullptr), right_path(nullptr), up(nullptr)
 {
 
 }
@@ -74,903 +126,2988 @@ std::string Linus::jsondiff::TreeLevel::to_info()
     std::ostringstream info;
     info << "{\"left\":" << ValueToString(left)
            << ",\"right\":" << ValueToString(right)
-           << ",\"left_path\":" << left_path
-           << ",\"right_path\":" << right_path << "}";
+           << ",\"left_path\":" << PathToString(left_path)
+           << ",\"right_path\":" << PathToString(right_path) << "}";
+    return info.str();
+}
+
+std::string Linus::jsondiff::TreeLevel::to_json(const std::string& event)
+{
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    std::string path_left = PathToString(left_path);
+    std::string path_right = PathToString(right_path);
+    writer.StartObject();
+    writer.Key("event");
+    writer.String(event.c_str(), event.size());
+    writer.Key("left");
+    left.Accept(writer);
+    writer.Key("right");
+    right.Accept(writer);
+    writer.Key("left_path");
+    writer.String(path_left.c_str(), path_left.size());
+    writer.Key("right_path");
+    writer.String(path_right.c_str(), path_right.size());
+    writer.EndObject();
+    return buffer.GetString();
+}
+
+//an array that was paired by hash or index has no value of its own to show, only where it is
+std::string Linus::jsondiff::TreeLevel::to_path_info()
+{
+    std::ostringstream info;
+    info << "{\"left_path\":" << PathToString(left_path)
+           << ",\"right_path\":" << PathToString(right_path) << "}";
     return info.str();
 }
 
+std::string Linus::jsondiff::TreeLevel::to_path_json(const std::string& event)
+{
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    std::string path_left = PathToString(left_path);
+    std::string path_right = PathToString(right_path);
+    writer.StartObject();
+    writer.Key("event");
+    writer.String(event.c_str(), event.size());
+    writer.Key("left_path");
+    writer.String(path_left.c_str(), path_left.size());
+    writer.Key("right_path");
+    writer.String(path_right.c_str(), path_right.size());
+    writer.EndObject();
+    return buffer.GetString();
+}
+
 std::string Linus::jsondiff::TreeLevel::get_key()
 {
     std::ostringstream key;
-    key << left_path << "/" << right_path;
+    key << PathToString(left_path) << "/" << PathToString(right_path);
     return key.str();
 }
 
-Linus::jsondiff::JsonDiffer::JsonDiffer(const rapidjson::Value& left_input, const rapidjson::Value& right_input, bool advanced, bool hirscheburg, double similarity_threshold, int thread_count) :left(left_input), right(right_input), advanced_mode(advanced), hirscheburg(hirscheburg), SIMILARITY_THRESHOLD(similarity_threshold), num_thread(thread_count)
+Linus::jsondiff::SimilarityCache::SimilarityCache(unsigned int capacity) : locks(new std::mutex[LOCK_STRIPES]), hit_count(0), miss_count(0), eviction_count(0)
 {
+    resize(capacity);
+}
 
+//not thread safe, only call it before or after diffing
+void Linus::jsondiff::SimilarityCache::resize(unsigned int capacity)
+{
+    unsigned int buckets = 1;
+    while (buckets * BUCKET_SIZE < capacity)
+    {
+        buckets <<= 1;
+    }
+    bucket_mask = buckets - 1;
+    slots.assign(buckets * BUCKET_SIZE, Entry{nullptr, nullptr, 0.0});
+    victims.assign(buckets, 0);
 }
 
-void Linus::jsondiff::JsonDiffer::report(std::string event, Linus::jsondiff::TreeLevel level)
+void Linus::jsondiff::SimilarityCache::clear()
 {
-    records[event].push_back(level.to_info());
+    std::fill(slots.begin(), slots.end(), Entry{nullptr, nullptr, 0.0});
+    std::fill(victims.begin(), victims.end(), 0);
+    hit_count = 0;
+    miss_count = 0;
+    eviction_count = 0;
 }
 
-std::map<std::string, std::vector<std::string>> Linus::jsondiff::JsonDiffer::to_info()
+unsigned int Linus::jsondiff::SimilarityCache::bucket_of(const rapidjson::Value* left, const rapidjson::Value* right)
 {
-    return records;
+    std::uint64_t key = reinterpret_cast<std::uintptr_t>(left) * 0x9e3779b97f4a7c15ULL ^ reinterpret_cast<std::uintptr_t>(right);
+    key ^= key >> 32;
+    key *= 0xd6e8feb86659fd93ULL;
+    key ^= key >> 32;
+    return static_cast<unsigned int>(key) & bucket_mask;
 }
 
-double Linus::jsondiff::JsonDiffer::compare_array(Linus::jsondiff::TreeLevel level, bool drill)
+bool Linus::jsondiff::SimilarityCache::find(const rapidjson::Value* left, const rapidjson::Value* right, double& score)
 {
-    double score;
-    if (std::max(level.left.Size(), level.right.Size()) == 0)
-    {
-        return 1;
-    }
-    if (advanced_mode)
+    unsigned int bucket = bucket_of(left, right);
     {
-        return compare_array_advanced(level, drill);
+        std::lock_guard<std::mutex> lock(locks[bucket % LOCK_STRIPES]);
+        for (unsigned int i = bucket * BUCKET_SIZE; i < (bucket + 1) * BUCKET_SIZE; ++i)
+        {
+            if (slots[i].left == left && slots[i].right == right)
+            {
+                score = slots[i].score;
+                hit_count.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
     }
-    else
+    miss_count.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+//open addressing inside a bucket, a full bucket evicts its entries round robin so memory stays fixed
+void Linus::jsondiff::SimilarityCache::insert(const rapidjson::Value* left, const rapidjson::Value* right, double score)
+{
+    unsigned int bucket = bucket_of(left, right);
+    std::lock_guard<std::mutex> lock(locks[bucket % LOCK_STRIPES]);
+    for (unsigned int i = bucket * BUCKET_SIZE; i < (bucket + 1) * BUCKET_SIZE; ++i)
     {
-        return compare_array_fast(level, drill);
+        if (slots[i].left == nullptr || (slots[i].left == left && slots[i].right == right))
+        {
+            slots[i] = Entry{left, right, score};
+            return;
+        }
     }
+    unsigned int victim = victims[bucket];
+    victims[bucket] = (victim + 1) % BUCKET_SIZE;
+    slots[bucket * BUCKET_SIZE + victim] = Entry{left, right, score};
+    eviction_count.fetch_add(1, std::memory_order_relaxed);
 }
 
-double Linus::jsondiff::JsonDiffer::compare_array_fast(Linus::jsondiff::TreeLevel level, bool drill)
+std::uint64_t Linus::jsondiff::SimilarityCache::hits()
 {
-    unsigned int len_left = level.left.Size();
-    unsigned int len_right = level.right.Size();
-    unsigned int min_len = std::min(len_left, len_right);
-    unsigned int max_len = std::max(len_left, len_right);
+    return hit_count.load();
+}
 
-    double total_score = 0;
-    double score_;
-    for (unsigned int index = 0; index < min_len; ++index)
+std::uint64_t Linus::jsondiff::SimilarityCache::misses()
+{
+    return miss_count.load();
+}
+
+std::uint64_t Linus::jsondiff::SimilarityCache::evictions()
+{
+    return eviction_count.load();
+}
+
+Linus::jsondiff::JsonDiffer::JsonDiffer(const rapidjson::Value& left_input, const rapidjson::Value& right_input, bool advanced, bool hirscheburg, double similarity_threshold, int thread_count) :SIMILARITY_THRESHOLD(similarity_threshold), left(left_input), right(right_input), cache(262144), advanced_mode(advanced), hirscheburg(hirscheburg), myers(false), auto_match_key(false), band(0), max_band(4096), lsh_bands(0), lsh_rows(4), work_budget(0), work_spent(0), deadline(std::chrono::steady_clock::time_point::max()), num_thread(thread_count), arena(std::max(1, thread_count)), sink(nullptr)
+{
+    //only the advanced mode pairs subtrees by digest; the fast mode walks equal subtrees instead of paying for a map entry per node
+    if (advanced_mode)
     {
-        std::ostringstream _left_path;
-        _left_path << level.left_path << "[" << std::to_string(index) << "]";
-        std::string left_path = _left_path.str();
-        std::ostringstream _right_path;
-        _right_path << level.right_path << "[" << std::to_string(index) << "]";
-        std::string right_path = _right_path.str();
-        Linus::jsondiff::TreeLevel level_(level.left[index], level.right[index], left_path, right_path, level.left_path);
-        score_ = diff_level(level_, drill);
-        total_score += score_;
+        build_digest(left);
+        build_digest(right);
     }
+}
 
-    rapidjson::Value emptyValue("");
-    const rapidjson::Value& emptyRef = emptyValue;
-    for (unsigned int index = min_len; index < len_left; ++index)
+const char* const Linus::jsondiff::PerfCounters::NAMES[] = {"cycles", "instructions", "cache_misses", "branch_misses"};
+
+//counts user space only, which needs no more than perf_event_paranoid 2; inherited counts reach these fds when the threads
+//exit, so TBB workers that are still alive are missing from them, while -N 1 keeps every comparison on the main thread
+Linus::jsondiff::PerfCounters::PerfCounters()
+{
+#ifdef __linux__
+    const std::uint64_t configs[COUNT] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    for (int i = 0; i < COUNT; ++i)
     {
-        if (!drill) 
+        struct perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = configs[i];
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        if (fds[i] != -1)
         {
-            std::ostringstream _left_path;
-            _left_path << level.left_path << "[" << std::to_string(index) << "]";
-            std::string left_path = _left_path.str();
-            Linus::jsondiff::TreeLevel level_(level.left[index], emptyRef, left_path, level.empty_string, level.left_path);
-            Linus::jsondiff::JsonDiffer::report(EVENT_ARRAY_REMOVE, level_);
+            ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
         }
     }
-    for (unsigned int index = min_len; index < len_right; ++index)
+#else
+    for (int i = 0; i < COUNT; ++i)
     {
-        if (!drill) 
-        {
-            std::ostringstream _right_path;
-            _right_path << level.right_path << "[" << std::to_string(index) << "]";
-            std::string right_path = _right_path.str();
-            Linus::jsondiff::TreeLevel level_(emptyRef, level.right[index], level.empty_string, right_path, level.right_path);
-            Linus::jsondiff::JsonDiffer::report(EVENT_ARRAY_ADD, level_);
-        }
+        fds[i] = -1;
     }
-    return total_score / max_len;
+#endif
 }
 
-int Linus::jsondiff::JsonDiffer::get_type(const rapidjson::Value& input)
+Linus::jsondiff::PerfCounters::~PerfCounters()
 {
-    if (input.IsObject())
+#ifdef __linux__
+    for (int i = 0; i < COUNT; ++i)
     {
-        return 0;
+        if (fds[i] != -1) close(fds[i]);
     }
-    else if (input.IsArray())
+#endif
+}
+
+bool Linus::jsondiff::PerfCounters::read(int index, std::uint64_t& value)
+{
+#ifdef __linux__
+    return fds[index] != -1 && ::read(fds[index], &value, sizeof(value)) == static_cast<ssize_t>(sizeof(value));
+#else
+    return false;
+#endif
+}
+
+const char* const Linus::jsondiff::Stats::COUNTER_NAMES[] = {"nodes_visited", "drill_calls", "dp_cells", "scratch_bytes", "records_emitted", "arrays_downgraded", "cache_hits", "cache_misses", "cache_evictions"};
+const char* const Linus::jsondiff::Stats::PEAK_NAMES[] = {"peak_dp_bytes"};
+const char* const Linus::jsondiff::Stats::TIMER_NAMES[] = {"parse", "parse_left", "parse_right", "diff", "wavefront_fill", "lcs_traceback"};
+bool Linus::jsondiff::Stats::enabled = false;
+std::mutex Linus::jsondiff::Stats::registry_mutex;
+std::vector<std::unique_ptr<Linus::jsondiff::Stats>> Linus::jsondiff::Stats::registry;
+
+Linus::jsondiff::Stats::Stats()
+{
+    std::fill(counters, counters + COUNTER_COUNT, 0);
+    std::fill(peaks, peaks + PEAK_COUNT, 0);
+    std::fill(timers, timers + TIMER_COUNT, 0.0);
+}
+
+//the registry owns every thread's instance, so the counts of threads that have exited are still summed
+Linus::jsondiff::Stats& Linus::jsondiff::Stats::local()
+{
+    thread_local Linus::jsondiff::Stats* slots = nullptr;
+    if (slots == nullptr)
     {
-        return 1;
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        registry.emplace_back(new Linus::jsondiff::Stats());
+        slots = registry.back().get();
     }
-    else if (input.IsString())
+    return *slots;
+}
+
+//timers add up over threads, so a parallel phase reports its thread time rather than its wall time
+std::string Linus::jsondiff::Stats::to_json(Linus::jsondiff::PerfCounters* hardware)
+{
+    Linus::jsondiff::Stats total;
     {
-        return 2;
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        for (const auto& slots : registry)
+        {
+            for (int i = 0; i < COUNTER_COUNT; ++i) total.counters[i] += slots->counters[i];
+            for (int i = 0; i < PEAK_COUNT; ++i) total.peaks[i] = std::max(total.peaks[i], slots->peaks[i]);
+            for (int i = 0; i < TIMER_COUNT; ++i) total.timers[i] += slots->timers[i];
+        }
     }
-    else if (input.IsInt())
+    std::ostringstream json;
+    json << "{\"counters\":{";
+    for (int i = 0; i < COUNTER_COUNT; ++i)
     {
-        return 3;
+        json << (i > 0 ? "," : "") << "\"" << COUNTER_NAMES[i] << "\":" << total.counters[i];
     }
-    else if (input.IsDouble())
+    json << "},\"peaks\":{";
+    for (int i = 0; i < PEAK_COUNT; ++i)
     {
-        return 4;
+        json << (i > 0 ? "," : "") << "\"" << PEAK_NAMES[i] << "\":" << total.peaks[i];
     }
-    else if (input.IsBool())
+    json << "},\"timers\":{";
+    for (int i = 0; i < TIMER_COUNT; ++i)
     {
-        return 5;
+        json << (i > 0 ? "," : "") << "\"" << TIMER_NAMES[i] << "\":" << total.timers[i];
     }
-    else
+    json << "}";
+    if (hardware != nullptr)
     {
-        return 6;
+        json << ",\"hardware\":{";
+        bool first = true;
+        for (int i = 0; i < Linus::jsondiff::PerfCounters::COUNT; ++i)
+        {
+            std::uint64_t value;
+            if (hardware->read(i, value))
+            {
+                json << (first ? "" : ",") << "\"" << Linus::jsondiff::PerfCounters::NAMES[i] << "\":" << value;
+                first = false;
+            }
+        }
+        json << "}";
     }
+    json << "}";
+    return json.str();
 }
 
-void Linus::jsondiff::JsonDiffer::parallel_diff_level(std::queue<std::pair<unsigned int, unsigned int>>& work_queue, std::vector<std::vector<double>>& dp, Linus::jsondiff::TreeLevel& level, std::mutex& work_queue_mutex, std::mutex& dp_mutex)
+Linus::jsondiff::StatTimer::StatTimer(Linus::jsondiff::Stats::Timer timer_input) : timer(timer_input), running(Linus::jsondiff::Stats::enabled)
 {
-    bool ctn = true;
-    int volumn = 6;
-    while (ctn)
+    if (running)
     {
-        std::vector<std::pair<unsigned int, unsigned int>> task_list(volumn);
-        int count = 0;
-        {
-            std::lock_guard<std::mutex> lock(work_queue_mutex);
-            for (int i = 0; i < volumn; ++i)
-            {
-                if (work_queue.empty())
-                {
-                    ctn = false;
-                    break;
-                }
-                task_list[i] = work_queue.front();
-                work_queue.pop();
-                ++count;
-            }
-            //std::cout << std::to_string(task.first) << ":" << std::to_string(task.second) << std::endl;
-        }
-        
-        std::vector<double> score_(volumn);
-        for (int i = 0; i < count; ++i)
-        {
-            score_[i] = (level.left[task_list[i].first].GetInt() == level.right[task_list[i].second].GetInt());
-        }
-        {
-            std::lock_guard<std::mutex> lock(dp_mutex);
-            for (int i = 0; i < count; ++i)
-            {
-                dp[task_list[i].first + 1][task_list[i].second + 1] = score_[i];
-            }
-        }
+        start = std::chrono::steady_clock::now();
     }
 }
 
-std::map<unsigned int, unsigned int> Linus::jsondiff::JsonDiffer::parallel_LCS(Linus::jsondiff::TreeLevel level)
+Linus::jsondiff::StatTimer::~StatTimer()
 {
-    unsigned int len_left = level.left.Size();
-    unsigned int len_right = level.right.Size();
-    std::vector<int> type_left(len_left);
-    std::vector<int> type_right(len_right);
-    std::vector<std::vector<double>> dp(len_left + 1, std::vector<double>(len_right + 1, 0.0));
-    std::queue<std::pair<unsigned int, unsigned int>> work_queue;
-    
+    if (running)
+    {
+        Linus::jsondiff::Stats::add_time(timer, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+}
+
+Linus::jsondiff::ScratchArena::ScratchArena() : block(0), top(0)
+{
+    std::size_t size = BLOCK_SIZE;
+    blocks.emplace_back(new char[size]);
+    sizes.push_back(size);
+}
 
-    auto pLstart = std::chrono::high_resolution_clock::now();
+Linus::jsondiff::ScratchArena& Linus::jsondiff::ScratchArena::local()
+{
+    thread_local Linus::jsondiff::ScratchArena arena;
+    return arena;
+}
 
-    for (unsigned int i = 0; i < len_left; ++i)
+void* Linus::jsondiff::ScratchArena::allocate(std::size_t bytes)
+{
+    bytes = (bytes + 15) & ~static_cast<std::size_t>(15);
+    Linus::jsondiff::Stats::count(Linus::jsondiff::Stats::SCRATCH_BYTES, bytes);
+    if (top + bytes <= sizes[block])
     {
-        for (unsigned int j = 0; j < len_right; ++j)
-        {
-            work_queue.push(std::make_pair(i, j));
-        }
+        void* result = blocks[block].get() + top;
+        top += bytes;
+        return result;
+    }
+    //blocks past the current one hold nothing live, so the next one is reused or replaced by a bigger one
+    std::size_t next = block + 1;
+    std::size_t size = bytes > BLOCK_SIZE ? bytes : BLOCK_SIZE;
+    if (next == blocks.size())
+    {
+        blocks.emplace_back(new char[size]);
+        sizes.push_back(size);
+    }
+    else if (sizes[next] < bytes)
+    {
+        blocks[next].reset(new char[size]);
+        sizes[next] = size;
     }
+    block = next;
+    top = bytes;
+    return blocks[next].get();
+}
 
-    auto pLfinish = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> pLelapsed = pLfinish - pLstart;
-    std::cout << "Building worklist: " << pLelapsed.count() << " s\n";
+//2 bits per cell, rows padded to whole bytes so tiles starting on a multiple of 4 columns never share a byte
+Linus::jsondiff::DirectionPlane::DirectionPlane(std::size_t rows, std::size_t columns) : stride((columns + 3) / 4), bits(rows * stride, 0)
+{
+    Linus::jsondiff::Stats::peak(Linus::jsondiff::Stats::PEAK_DP_BYTES, bits.size());
+}
 
-    std::mutex work_queue_mutex;
-    std::mutex dp_mutex;
-    std::vector<std::thread> threads;
+void Linus::jsondiff::DirectionPlane::set(std::size_t row, std::size_t column, unsigned char direction)
+{
+    std::uint8_t& cell = bits[row * stride + column / 4];
+    unsigned int shift = (column % 4) * 2;
+    cell = static_cast<std::uint8_t>((cell & ~(3u << shift)) | (direction << shift));
+}
 
-    pLstart = std::chrono::high_resolution_clock::now();
+unsigned char Linus::jsondiff::DirectionPlane::get(std::size_t row, std::size_t column) const
+{
+    return (bits[row * stride + column / 4] >> ((column % 4) * 2)) & 3;
+}
 
-    for (int i = 0; i < num_thread; ++i)
-    {
-        threads.push_back(std::thread(&Linus::jsondiff::JsonDiffer::parallel_diff_level, this, std::ref(work_queue), std::ref(dp), std::ref(level), std::ref(work_queue_mutex), std::ref(dp_mutex)));
-    }
+Linus::jsondiff::JsonSource::JsonSource() : data(nullptr), size(0), mapped(0), parse_time(0)
+{
 
-    pLfinish = std::chrono::high_resolution_clock::now();
-    pLelapsed = pLfinish - pLstart;
-    std::cout << "Allocating threads: " << pLelapsed.count() << " s\n";
+}
 
-    pLstart = std::chrono::high_resolution_clock::now();
+Linus::jsondiff::JsonSource::~JsonSource()
+{
+    release();
+}
 
-    for (auto& thread : threads)
+void Linus::jsondiff::JsonSource::open(const std::string& json, bool populate, bool huge_pages)
+{
+    release();
+    if (json[0] == '{' or json[0] == '[')
+    {
+        copy.assign(json.begin(), json.end());
+        copy.push_back('\0');
+        data = copy.data();
+        size = json.size();
+    }
+    else
     {
-        thread.join();
+        map_file(json, populate, huge_pages);
     }
+}
 
-    pLfinish = std::chrono::high_resolution_clock::now();
-    pLelapsed = pLfinish - pLstart;
-    std::cout << "Parallel computing scores: " << pLelapsed.count() << " s\n";
+//the document is parsed in place, so its strings point into data until release()
+void Linus::jsondiff::JsonSource::load(const std::string& json, bool populate, bool huge_pages)
+{
+    open(json, populate, huge_pages);
+    auto start = std::chrono::high_resolution_clock::now();
+    document.ParseInsitu(data);
+    auto finish = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = finish - start;
+    parse_time = elapsed.count();
+}
 
-    //output dp table
-    /*std::cout << "Before reconstruction" << std::endl;
-    for (unsigned int i = 0; i <= len_left; ++i)
+#ifndef _WIN32
+//private writable mapping plus one zero page behind it, which terminates the text for ParseInsitu
+void Linus::jsondiff::JsonSource::map_file(const std::string& path, bool populate, bool huge_pages)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
     {
-        for (unsigned int j = 0; j <= len_right; ++j)
-        {
-            std::cout << dp[i][j] << " ";
-        }
-        std::cout << std::endl;
-    }*/
-    
-    pLstart = std::chrono::high_resolution_clock::now();
-
-    //reconstruct dp table according to the result of parallel computing
-    for (unsigned int i = 1; i <= len_left; ++i)
+        std::cerr << "Cannot open file: " << path << std::endl;
+        throw std::runtime_error("File open failed");
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0)
     {
-        for (unsigned int j = 1; j <= len_right; ++j)
-        {
-            if (dp[i][j] > 0)
-            {
-                dp[i][j] += dp[i - 1][j - 1];
-            }
-            else
-            {
-                dp[i][j] = std::max(dp[i - 1][j], dp[i][j - 1]);
-            }
-        }
+        close(fd);
+        throw std::runtime_error("File stat failed");
     }
-    //output dp table
-    /*std::cout << "After reconstruction" << std::endl;
-    for (unsigned int i = 0; i <= len_left; ++i)
+    size = info.st_size;
+    std::size_t page = sysconf(_SC_PAGESIZE);
+    mapped = (size / page + 1) * page;
+    void* region = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED)
     {
-        for (unsigned int j = 0; j <= len_right; ++j)
-        {
-            std::cout << dp[i][j] << " ";
-        }
-        std::cout << std::endl;
-    }*/
-    
-    pLfinish = std::chrono::high_resolution_clock::now();
-    pLelapsed = pLfinish - pLstart;
-    std::cout << "Reconstructing of dp table: " << pLelapsed.count() << " s\n";
-
-    std::map<unsigned int, unsigned int> pair_list;
-    unsigned int i = len_left;
-    unsigned int j = len_right;
-
-    pLstart = std::chrono::high_resolution_clock::now();
-
-    while (i > 0 && j > 0)
+        close(fd);
+        mapped = 0;
+        throw std::runtime_error("File map failed");
+    }
+    data = static_cast<char*>(region);
+    if (size > 0)
     {
-        Linus::jsondiff::TreeLevel level_(level.left[i - 1], level.right[j - 1], level.left_path + "[" + std::to_string(i - 1) + "]", level.right_path + "[" + std::to_string(j - 1) + "]", level.left_path);
-        double score_ = _diff_level(level_, true);
-        if (score_ >= SIMILARITY_THRESHOLD)
+        int flags = MAP_PRIVATE | MAP_FIXED;
+#ifdef MAP_POPULATE
+        if (populate)
         {
-            pair_list[i - 1] = j - 1;
-            --i;
-            --j;
+            flags |= MAP_POPULATE;
         }
-        else if (dp[i - 1][j] > dp[i][j - 1])
+#endif
+        if (mmap(data, size, PROT_READ | PROT_WRITE, flags, fd, 0) == MAP_FAILED)
         {
-            --i;
+            close(fd);
+            release();
+            throw std::runtime_error("File map failed");
         }
-        else
+#ifdef MADV_HUGEPAGE
+        if (huge_pages)
         {
-            --j;
+            madvise(data, mapped, MADV_HUGEPAGE);
         }
+#endif
+    }
+    close(fd);
+}
+
+void Linus::jsondiff::JsonSource::release()
+{
+    document.SetNull();
+    if (mapped != 0)
+    {
+        munmap(data, mapped);
     }
+    copy.clear();
+    data = nullptr;
+    size = 0;
+    mapped = 0;
+}
+#else
+//no mmap here, read the file once into a buffer that is parsed in place
+void Linus::jsondiff::JsonSource::map_file(const std::string& path, bool populate, bool huge_pages)
+{
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "Cannot open file: " << path << std::endl;
+        throw std::runtime_error("File open failed");
+    }
+    file.seekg(0, std::ios::end);
+    size = file.tellg();
+    file.seekg(0, std::ios::beg);
+    copy.resize(size + 1);
+    file.read(copy.data(), size);
+    copy[size] = '\0';
+    data = copy.data();
+}
 
-    pLfinish = std::chrono::high_resolution_clock::now();
-    pLelapsed = pLfinish - pLstart;
-    std::cout << "Retreiving LCS: " << pLelapsed.count() << " s\n";
+void Linus::jsondiff::JsonSource::release()
+{
+    document.SetNull();
+    copy.clear();
+    data = nullptr;
+    size = 0;
+    mapped = 0;
+}
+#endif
 
-    return pair_list;
+Linus::jsondiff::DiffSink::DiffSink(std::ostream& output, std::size_t buffer_size) : stream(&output), capacity(buffer_size), count(0), last_flush(std::chrono::steady_clock::now())
+{
+    pending.reserve(capacity);
 }
 
-std::map<unsigned int, unsigned int> Linus::jsondiff::JsonDiffer::LCS(Linus::jsondiff::TreeLevel level, bool drill)
+Linus::jsondiff::DiffSink::DiffSink(std::function<void(const std::string&)> output) : stream(nullptr), callback(output), capacity(0), count(0), last_flush(std::chrono::steady_clock::now())
 {
-    unsigned int len_left = level.left.Size();
-    unsigned int len_right = level.right.Size();
-    std::vector<int> type_left(len_left);
-    std::vector<int> type_right(len_right);
-    std::vector<std::vector<double>> dp(len_left + 1, std::vector<double>(len_right + 1, 0.0));
 
-    //auto Lstart = std::chrono::high_resolution_clock::now();
+}
 
-    for (unsigned int i = 0; i < len_left; ++i)
+Linus::jsondiff::DiffSink::~DiffSink()
+{
+    flush();
+}
+
+//one JSON object per line, the first line and anything older than FLUSH_INTERVAL_MS goes out immediately
+void Linus::jsondiff::DiffSink::write(const std::string& line)
+{
+    if (stream == nullptr)
     {
-        type_left[i] =  Linus::jsondiff::JsonDiffer::get_type(level.left[i]);
+        callback(line);
+        ++count;
+        return;
     }
-    for (unsigned int j = 0; j < len_right; ++j)
+    pending.append(line).push_back('\n');
+    ++count;
+    auto now = std::chrono::steady_clock::now();
+    if (count == 1 || pending.size() >= capacity || std::chrono::duration_cast<std::chrono::milliseconds>(now - last_flush).count() >= FLUSH_INTERVAL_MS)
     {
-        type_right[j] = Linus::jsondiff::JsonDiffer::get_type(level.right[j]);
+        flush();
+        last_flush = now;
     }
+}
 
-    //auto Lfinish = std::chrono::high_resolution_clock::now();
-    //std::chrono::duration<double> getting_types = Lfinish - Lstart;
-    //if(!drill)    std::cout << "LCS: getting types: " << getting_types.count() << std::endl;
-
-    //Lstart = std::chrono::high_resolution_clock::now();
-
+void Linus::jsondiff::DiffSink::flush()
+{
+    if (stream == nullptr || pending.empty())
+    {
+        return;
+    }
+    stream->write(pending.data(), pending.size());
+    stream->flush();
+    pending.clear();
+}
+
+Linus::jsondiff::DiffBuffer::DiffBuffer() : done(false)
+{
+
+}
+
+void Linus::jsondiff::DiffBuffer::push(const std::string& event, const std::string& info)
+{
+    entries.emplace_back(event, info);
+}
+
+Linus::jsondiff::DiffBuffer* Linus::jsondiff::DiffBuffer::branch()
+{
+    branches.emplace_back(entries.size(), std::unique_ptr<Linus::jsondiff::DiffBuffer>(new Linus::jsondiff::DiffBuffer()));
+    return branches.back().second.get();
+}
+
+//replay entries and branches in the order a single thread would have reported them
+void Linus::jsondiff::DiffBuffer::merge(std::map<std::string, std::vector<std::string>>& records)
+{
+    std::size_t next = 0;
+    for (std::size_t i = 0; i <= entries.size(); ++i)
+    {
+        while (next < branches.size() && branches[next].first == i)
+        {
+            branches[next].second->merge(records);
+            ++next;
+        }
+        if (i < entries.size())
+        {
+            records[entries[i].first].push_back(std::move(entries[i].second));
+        }
+    }
+    clear();
+}
+
+//write the prefix whose branches have finished, keep the rest for a later flush
+bool Linus::jsondiff::DiffBuffer::flush(Linus::jsondiff::DiffSink& sink)
+{
+    std::size_t next = 0;
+    std::size_t written = 0;
+    bool complete = true;
+    for (std::size_t i = 0; i <= entries.size() && complete; ++i)
+    {
+        while (next < branches.size() && branches[next].first == i)
+        {
+            if (!branches[next].second->done.load(std::memory_order_acquire))
+            {
+                complete = false;
+                break;
+            }
+            branches[next].second->flush(sink);
+            ++next;
+        }
+        if (complete && i < entries.size())
+        {
+            sink.write(entries[i].second);
+            ++written;
+        }
+    }
+    entries.erase(entries.begin(), entries.begin() + written);
+    branches.erase(branches.begin(), branches.begin() + next);
+    for (auto& branch : branches)
+    {
+        branch.first -= written;
+    }
+    return complete;
+}
+
+void Linus::jsondiff::DiffBuffer::clear()
+{
+    entries.clear();
+    branches.clear();
+}
+
+void Linus::jsondiff::JsonDiffer::report(std::string event, Linus::jsondiff::TreeLevel level)
+{
+    emit(event, sink != nullptr ? level.to_json(event) : level.to_info());
+}
+
+void Linus::jsondiff::JsonDiffer::report_paths(std::string event, Linus::jsondiff::TreeLevel level)
+{
+    emit(event, sink != nullptr ? level.to_path_json(event) : level.to_path_info());
+}
+
+void Linus::jsondiff::JsonDiffer::emit(const std::string& event, std::string info)
+{
+    Linus::jsondiff::Stats::count(Linus::jsondiff::Stats::RECORDS_EMITTED, 1);
+    if (current_buffer != nullptr && (sink == nullptr || current_buffer != &buffer || !buffer.entries.empty() || !buffer.branches.empty()))
+    {
+        current_buffer->push(event, info);
+    }
+    else if (sink != nullptr)
+    {
+        sink->write(info);
+    }
+    else
+    {
+        records[event].push_back(info);
+    }
+}
+
+std::map<std::string, std::vector<std::string>> Linus::jsondiff::JsonDiffer::to_info()
+{
+    return records;
+}
+
+double Linus::jsondiff::JsonDiffer::compare_array(Linus::jsondiff::TreeLevel level, bool drill)
+{
+    double score;
+    if (std::max(level.left.Size(), level.right.Size()) == 0)
+    {
+        return 1;
+    }
+    if (advanced_mode)
+    {
+        return compare_array_advanced(level, drill);
+    }
+    else
+    {
+        return compare_array_fast(level, drill);
+    }
+}
+
+double Linus::jsondiff::JsonDiffer::compare_array_fast(Linus::jsondiff::TreeLevel level, bool drill)
+{
+    unsigned int len_left = level.left.Size();
+    unsigned int len_right = level.right.Size();
+    unsigned int min_len = std::min(len_left, len_right);
+    unsigned int max_len = std::max(len_left, len_right);
+
+    double total_score = 0;
+    Linus::jsondiff::Scratch<double> scores(min_len, 0.0);
+    tbb::task_group group;
+    for (unsigned int index = 0; index < min_len; ++index)
+    {
+        auto task = [this, &level, &scores, index, drill]()
+        {
+            Linus::jsondiff::PathNode left_path(level.left_path, index);
+            Linus::jsondiff::PathNode right_path(level.right_path, index);
+            Linus::jsondiff::TreeLevel level_(level.left[index], level.right[index], &left_path, &right_path, level.left_path);
+            scores[index] = diff_level(level_, drill);
+        };
+        if (spawn_task(level.left[index], level.right[index])) fork_task(group, task);
+        else task();
+    }
+    join_tasks(group);
+    for (unsigned int index = 0; index < min_len; ++index)
+    {
+        total_score += scores[index];
+    }
+
+    const rapidjson::Value& emptyRef = empty_value;
+    for (unsigned int index = min_len; index < len_left; ++index)
+    {
+        if (!drill) 
+        {
+            Linus::jsondiff::PathNode left_path(level.left_path, index);
+            Linus::jsondiff::TreeLevel level_(level.left[index], emptyRef, &left_path, nullptr, level.left_path);
+            Linus::jsondiff::JsonDiffer::report(EVENT_ARRAY_REMOVE, level_);
+        }
+    }
+    for (unsigned int index = min_len; index < len_right; ++index)
+    {
+        if (!drill) 
+        {
+            Linus::jsondiff::PathNode right_path(level.right_path, index);
+            Linus::jsondiff::TreeLevel level_(emptyRef, level.right[index], nullptr, &right_path, level.right_path);
+            Linus::jsondiff::JsonDiffer::report(EVENT_ARRAY_ADD, level_);
+        }
+    }
+    return total_score / max_len;
+}
+
+int Linus::jsondiff::JsonDiffer::get_type(const rapidjson::Value& input)
+{
+    if (input.IsObject())
+    {
+        return 0;
+    }
+    else if (input.IsArray())
+    {
+        return 1;
+    }
+    else if (input.IsString())
+    {
+        return 2;
+    }
+    else if (input.IsInt())
+    {
+        return 3;
+    }
+    else if (input.IsDouble())
+    {
+        return 4;
+    }
+    else if (input.IsBool())
+    {
+        return 5;
+    }
+    else
+    {
+        return 6;
+    }
+}
+
+static std::uint64_t mix_hash(std::uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static std::uint64_t hash_bytes(const char* str, unsigned int len)
+{
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned int i = 0; i < len; ++i)
+    {
+        hash ^= static_cast<unsigned char>(str[i]);
+        hash *= 0x100000001b3ULL;
+    }
+    return mix_hash(hash ^ len);
+}
+
+//structural hash and node count of every subtree, computed once so identical subtrees can be skipped
+//object members are combined by sum so that key order does not matter, array elements in order
+Linus::jsondiff::SubtreeDigest Linus::jsondiff::JsonDiffer::build_digest(const rapidjson::Value& input)
+{
+    Linus::jsondiff::SubtreeDigest digest;
+    digest.count = 1;
+    int type = Linus::jsondiff::JsonDiffer::get_type(input);
+    switch (type)
+    {
+        case 0:
+        {
+            std::uint64_t sum = 0;
+            for (auto iter = input.MemberBegin(); iter != input.MemberEnd(); ++iter)
+            {
+                Linus::jsondiff::SubtreeDigest child = build_digest(iter->value);
+                digest.count += child.count;
+                sum += mix_hash(hash_bytes(iter->name.GetString(), iter->name.GetStringLength()) ^ (child.hash * 31));
+            }
+            digest.hash = mix_hash(sum ^ input.MemberCount());
+            break;
+        }
+        case 1:
+        {
+            std::uint64_t hash = input.Size();
+            for (unsigned int i = 0; i < input.Size(); ++i)
+            {
+                Linus::jsondiff::SubtreeDigest child = build_digest(input[i]);
+                digest.count += child.count;
+                hash = mix_hash(hash * 31 + child.hash);
+            }
+            digest.hash = hash;
+            break;
+        }
+        case 2:
+            digest.hash = hash_bytes(input.GetString(), input.GetStringLength());
+            break;
+        case 3:
+            digest.hash = mix_hash(static_cast<std::uint64_t>(static_cast<std::int64_t>(input.GetInt())));
+            break;
+        case 4:
+        {
+            double value = input.GetDouble();
+            std::uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            digest.hash = mix_hash(bits);
+            break;
+        }
+        case 5:
+            digest.hash = mix_hash(input.GetBool());
+            break;
+        default:
+            if (input.IsNumber())
+            {
+                digest.hash = mix_hash(input.IsUint64() ? input.GetUint64() : static_cast<std::uint64_t>(input.GetInt64()));
+            }
+            else
+            {
+                digest.hash = 0;
+            }
+            break;
+    }
+    //mix the type in so that equal payloads of different types do not collide
+    digest.hash = mix_hash(digest.hash + static_cast<std::uint64_t>(type) * 0x2545f4914f6cdd1dULL + (input.IsNull() ? 1 : 0));
+    digests[&input] = digest;
+    return digest;
+}
+
+void Linus::jsondiff::JsonDiffer::drop_digest(const rapidjson::Value& input)
+{
+    digests.erase(&input);
+    if (input.IsObject())
+    {
+        if (input.MemberCount() >= KEY_INDEX_MIN)
+        {
+            std::unique_lock<std::shared_mutex> lock(key_index_mutex);
+            key_indexes.erase(&input);
+        }
+        for (auto iter = input.MemberBegin(); iter != input.MemberEnd(); ++iter)
+        {
+            drop_digest(iter->value);
+        }
+    }
+    else if (input.IsArray())
+    {
+        for (unsigned int i = 0; i < input.Size(); ++i)
+        {
+            drop_digest(input[i]);
+        }
+    }
+}
+
+static int compare_name(const rapidjson::Value::Member* left, const rapidjson::Value::Member* right)
+{
+    unsigned int len_left = left->name.GetStringLength();
+    unsigned int len_right = right->name.GetStringLength();
+    int order = std::memcmp(left->name.GetString(), right->name.GetString(), std::min(len_left, len_right));
+    if (order != 0)
+    {
+        return order;
+    }
+    return len_left < len_right ? -1 : (len_left > len_right ? 1 : 0);
+}
+
+//members sorted by name, stable so that the first of duplicated keys stays first
+//wide objects keep their index for the lifetime of the differ, small ones are sorted into scratch sized to MemberCount
+const rapidjson::Value::Member* const* Linus::jsondiff::JsonDiffer::key_index(const rapidjson::Value& object, Linus::jsondiff::Scratch<const rapidjson::Value::Member*>& scratch)
+{
+    bool keep = object.MemberCount() >= KEY_INDEX_MIN;
+    if (keep)
+    {
+        std::shared_lock<std::shared_mutex> lock(key_index_mutex);
+        auto iter = key_indexes.find(&object);
+        if (iter != key_indexes.end())
+        {
+            return iter->second.data();
+        }
+    }
+    unsigned int count = 0;
+    for (auto iter = object.MemberBegin(); iter != object.MemberEnd(); ++iter)
+    {
+        scratch[count++] = &*iter;
+    }
+    if (!keep)
+    {
+        //insertion sort is stable too and, unlike std::stable_sort, needs no temporary buffer
+        for (unsigned int i = 1; i < count; ++i)
+        {
+            const rapidjson::Value::Member* member = scratch[i];
+            unsigned int j = i;
+            for (; j > 0 && compare_name(member, scratch[j - 1]) < 0; --j)
+            {
+                scratch[j] = scratch[j - 1];
+            }
+            scratch[j] = member;
+        }
+        return scratch.begin();
+    }
+    std::stable_sort(scratch.begin(), scratch.end(), [](const rapidjson::Value::Member* left, const rapidjson::Value::Member* right)
+    {
+        return compare_name(left, right) < 0;
+    });
+    std::unique_lock<std::shared_mutex> lock(key_index_mutex);
+    return key_indexes.emplace(&object, std::vector<const rapidjson::Value::Member*>(scratch.begin(), scratch.end())).first->second.data();
+}
+
+std::uint64_t Linus::jsondiff::JsonDiffer::get_hash(const rapidjson::Value& input)
+{
+    auto iter = digests.find(&input);
+    if (iter == digests.end())
+    {
+        //values outside of the two documents never equal anything but themselves
+        return static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(&input));
+    }
+    return iter->second.hash;
+}
+
+//the DPs score any two type 6 elements (null, Int64, Uint64) as equal, so the array hashes that Myers and the anchors pair
+//by give them all one hash
+std::uint64_t Linus::jsondiff::JsonDiffer::element_hash(const rapidjson::Value& input, int type)
+{
+    return type == 6 ? OTHER_HASH : get_hash(input);
+}
+
+unsigned int Linus::jsondiff::JsonDiffer::get_count(const rapidjson::Value& input)
+{
+    auto iter = digests.find(&input);
+    if (iter == digests.end())
+    {
+        return 1;
+    }
+    return iter->second.count;
+}
+
+//sibling subtrees are only diffed as separate tasks when they are large enough to pay for the scheduling; the fast mode
+//builds no digests, so there the number of children stands in for the subtree size
+bool Linus::jsondiff::JsonDiffer::spawn_task(const rapidjson::Value& left, const rapidjson::Value& right)
+{
+    if (num_thread <= 1)
+    {
+        return false;
+    }
+    if (advanced_mode)
+    {
+        return get_count(left) + get_count(right) >= TASK_CUTOFF;
+    }
+    auto width = [](const rapidjson::Value& input) -> unsigned int
+    {
+        if (input.IsObject()) return input.MemberCount();
+        if (input.IsArray()) return input.Size();
+        return 0;
+    };
+    return width(left) + width(right) >= TASK_FANOUT;
+}
+
+//each spawned task reports into its own branch of the parent buffer, so no report is shared between threads
+void Linus::jsondiff::JsonDiffer::fork_task(tbb::task_group& group, std::function<void()> task)
+{
+    if (current_buffer == nullptr)
+    {
+        task();
+        return;
+    }
+    Linus::jsondiff::DiffBuffer* branch = current_buffer->branch();
+    group.run([branch, task]()
+    {
+        Linus::jsondiff::DiffBuffer* saved = current_buffer;
+        current_buffer = branch;
+        task();
+        current_buffer = saved;
+        branch->done.store(true, std::memory_order_release);
+    });
+}
+
+//once the root frame has joined its tasks their differences can be streamed out
+void Linus::jsondiff::JsonDiffer::join_tasks(tbb::task_group& group)
+{
+    group.wait();
+    if (sink != nullptr && current_buffer == &buffer)
+    {
+        buffer.flush(*sink);
+    }
+}
+
+//the weighted DP over cells element pairs costs about cells times the nodes of an average element of the array, as a drill
+//walks both elements of a pair. It runs when that fits both what is left of work_budget and, at WORK_PER_SECOND, the time
+//to the deadline; otherwise equal elements are paired on their hashes and the rest by position, or all of them by position
+//when even the cells do not fit
+int Linus::jsondiff::JsonDiffer::gap_match(Linus::jsondiff::TreeLevel& level, std::uint64_t cells)
+{
+    bool timed = deadline != std::chrono::steady_clock::time_point::max();
+    if (work_budget == 0 && !timed)
+    {
+        return FULL_MATCH;
+    }
+    double nodes = static_cast<double>(get_count(level.left)) + get_count(level.right);
+    double cost = cells * std::max(1.0, nodes / std::max(1u, level.left.Size() + level.right.Size()));
+    if (hirscheburg)
+    {
+        //the halves are refilled on every level of the recursion, and each split fills its strip twice
+        cost *= 3;
+    }
+    std::uint64_t spent = work_spent.load();
+    double allowed = work_budget == 0 ? std::numeric_limits<double>::max() : static_cast<double>(work_budget - std::min(work_budget, spent));
+    if (timed)
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline)
+        {
+            return INDEX_MATCH;
+        }
+        allowed = std::min(allowed, std::chrono::duration<double>(deadline - now).count() * WORK_PER_SECOND);
+    }
+    if (cost <= allowed)
+    {
+        work_spent.fetch_add(static_cast<std::uint64_t>(cost));
+        return FULL_MATCH;
+    }
+    if (cells <= allowed)
+    {
+        work_spent.fetch_add(cells);
+        return HASH_MATCH;
+    }
+    return INDEX_MATCH;
+}
+
+//the elements left between the pairs of left[sleft, eleft) x right[sright, eright) are paired by position, as in compare_array_fast
+void Linus::jsondiff::JsonDiffer::pair_gaps(std::map<unsigned int, unsigned int>& pair_list, unsigned int sleft, unsigned int eleft, unsigned int sright, unsigned int eright)
+{
+    std::vector<std::pair<unsigned int, unsigned int>> bounds(pair_list.lower_bound(sleft), pair_list.lower_bound(eleft));
+    bounds.push_back(std::make_pair(eleft, eright));
+    for (const auto& bound : bounds)
+    {
+        for (; sleft < bound.first && sright < bound.second; ++sleft, ++sright)
+        {
+            pair_list[sleft] = sright;
+        }
+        sleft = bound.first + 1;
+        sright = bound.second + 1;
+    }
+}
+
+//past the deadline drills score 0 without walking their subtrees, so a DP that is already running still finishes in time
+//and pairs nothing it has not scored
+bool Linus::jsondiff::JsonDiffer::out_of_time()
+{
+    return deadline != std::chrono::steady_clock::time_point::max() && std::chrono::steady_clock::now() >= deadline;
+}
+
+bool Linus::jsondiff::JsonDiffer::same_subtree(const rapidjson::Value& left, const rapidjson::Value& right)
+{
+    auto iter_left = digests.find(&left);
+    if (iter_left == digests.end())
+    {
+        return false;
+    }
+    auto iter_right = digests.find(&right);
+    if (iter_right == digests.end())
+    {
+        return false;
+    }
+    if (iter_left->second.hash != iter_right->second.hash || iter_left->second.count != iter_right->second.count)
+    {
+        return false;
+    }
+    //the digests only rule pairs out, a match is confirmed in full so that a collision cannot hide a difference
+    return left == right;
+}
+
+double Linus::jsondiff::JsonDiffer::pair_score(const rapidjson::Value& left, const rapidjson::Value& right, int type_left, int type_right, std::uint64_t hash_left, std::uint64_t hash_right)
+{
+    if (hash_left == hash_right && left == right)
+    {
+        return 1;
+    }
+    if (type_left != type_right)
+    {
+        return 0;
+    }
+    switch (type_left)
+    {
+        case 0:
+            return Linus::jsondiff::JsonDiffer::drill_obj(left, right, SIMILARITY_THRESHOLD);
+        case 1:
+            return Linus::jsondiff::JsonDiffer::drill_LCS(left, right, SIMILARITY_THRESHOLD);
+        case 2:
+            return (std::strcmp(left.GetString(), right.GetString()) == 0) ? 1 : 0;
+        case 3:
+            return (left.GetInt() == right.GetInt());
+        case 4:
+            return (left.GetDouble() == right.GetDouble());
+        case 5:
+            return (left.GetBool() == right.GetBool());
+        case 6:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+//fill one tile of the dp table, every cell it reads above or left of the tile belongs to an earlier anti-diagonal
+//fills one tile from the row above it and the column left of it, then leaves its own last row in bottom and last column in right_edge
+//for the tiles that follow; the cells themselves only survive as moves
+void Linus::jsondiff::JsonDiffer::fill_tile(Linus::jsondiff::TreeLevel& level, std::vector<int>& type_left, std::vector<std::uint64_t>& hash_left, unsigned int sleft, std::vector<int>& type_right, std::vector<std::uint64_t>& hash_right, unsigned int sright, std::vector<double>& bottom, std::vector<double>& above, std::vector<double>& right_edge, std::vector<double>& left_edge, Linus::jsondiff::DirectionPlane& moves, unsigned int row_begin, unsigned int row_end, unsigned int col_begin, unsigned int col_end)
+{
+    unsigned int width = col_end - col_begin;
+    Linus::jsondiff::Scratch<double> previous(width + 1, 0.0);
+    Linus::jsondiff::Scratch<double> current(width + 1, 0.0);
+    std::copy(above.begin() + col_begin - 1, above.begin() + col_end, previous.begin());
+    for (unsigned int i = row_begin; i < row_end; ++i)
+    {
+        current[0] = left_edge[i];
+        for (unsigned int j = col_begin; j < col_end; ++j)
+        {
+            unsigned int li = sleft + i - 1;
+            unsigned int rj = sright + j - 1;
+            unsigned int k = j - col_begin + 1;
+            double score_ = pair_score(level.left[li], level.right[rj], type_left[li], type_right[rj], hash_left[li], hash_right[rj]);
+            if (score_ >= SIMILARITY_THRESHOLD)
+            {
+                current[k] = previous[k - 1] + score_;
+                moves.set(i - 1, j - 1, Linus::jsondiff::DirectionPlane::DIAGONAL);
+            }
+            else
+            {
+                current[k] = std::max(previous[k], current[k - 1]);
+                moves.set(i - 1, j - 1, previous[k] > current[k - 1] ? Linus::jsondiff::DirectionPlane::UP : Linus::jsondiff::DirectionPlane::LEFT);
+            }
+        }
+        right_edge[i] = current[width];
+        previous.swap(current);
+    }
+    std::copy(previous.begin() + 1, previous.end(), bottom.begin() + col_begin);
+}
+
+//tiled wavefront LCS: the dp table is cut into tiles and all tiles on one anti-diagonal are filled in parallel,
+//tiles write disjoint cells so no locking is needed, only the wave boundary synchronises.
+//only the rows and columns on tile borders are kept, the traceback follows the moves recorded by the fill
+std::map<unsigned int, unsigned int> Linus::jsondiff::JsonDiffer::parallel_LCS(Linus::jsondiff::TreeLevel level, std::vector<int>& type_left, std::vector<std::uint64_t>& hash_left, unsigned int sleft, unsigned int eleft, std::vector<int>& type_right, std::vector<std::uint64_t>& hash_right, unsigned int sright, unsigned int eright)
+{
+    unsigned int len_left = eleft - sleft;
+    unsigned int len_right = eright - sright;
+
+    //nested elements make every cell expensive, so use small tiles to keep all threads busy
+    unsigned int tile = 256;
+    for (unsigned int i = sleft; i < eleft && tile > 16; ++i)
+    {
+        if (type_left[i] < 2) tile = 16;
+    }
+
+    unsigned int tile_rows = (len_left + tile - 1) / tile;
+    unsigned int tile_cols = (len_right + tile - 1) / tile;
+    //border_rows[r] is dp row r * tile (clamped to the last row), border_cols[c] is dp column c * tile
+    std::vector<std::vector<double>> border_rows(tile_rows + 1, std::vector<double>(len_right + 1, 0.0));
+    std::vector<std::vector<double>> border_cols(tile_cols + 1, std::vector<double>(len_left + 1, 0.0));
+    Linus::jsondiff::DirectionPlane moves(len_left, len_right);
+    Linus::jsondiff::Stats::count(Linus::jsondiff::Stats::DP_CELLS, static_cast<std::uint64_t>(len_left) * len_right);
+    {
+        Linus::jsondiff::StatTimer timer(Linus::jsondiff::Stats::WAVEFRONT_FILL);
+        arena.execute([&]
+        {
+            for (unsigned int wave = 0; wave + 1 < tile_rows + tile_cols; ++wave)
+            {
+                unsigned int first = (wave >= tile_cols) ? wave - tile_cols + 1 : 0;
+                unsigned int last = std::min(wave, tile_rows - 1);
+                tbb::parallel_for(first, last + 1, [&](unsigned int tile_row)
+                {
+                    unsigned int tile_col = wave - tile_row;
+                    unsigned int row_begin = tile_row * tile + 1;
+                    unsigned int col_begin = tile_col * tile + 1;
+                    fill_tile(level, type_left, hash_left, sleft, type_right, hash_right, sright, border_rows[tile_row + 1], border_rows[tile_row], border_cols[tile_col + 1], border_cols[tile_col], moves, row_begin, std::min(row_begin + tile, len_left + 1), col_begin, std::min(col_begin + tile, len_right + 1));
+                });
+            }
+        });
+    }
+
+    Linus::jsondiff::StatTimer timer(Linus::jsondiff::Stats::LCS_TRACEBACK);
+    std::map<unsigned int, unsigned int> pair_list;
+    unsigned int i = len_left;
+    unsigned int j = len_right;
+
+    while (i > 0 && j > 0)
+    {
+        unsigned char move = moves.get(i - 1, j - 1);
+        if (move == Linus::jsondiff::DirectionPlane::DIAGONAL)
+        {
+            pair_list[sleft + i - 1] = sright + j - 1;
+            --i;
+            --j;
+        }
+        else if (move == Linus::jsondiff::DirectionPlane::UP)
+        {
+            --i;
+        }
+        else
+        {
+            --j;
+        }
+    }
+
+    return pair_list;
+}
+
+//true when elements in [start, end) can only score 0 or 1 and score 1 exactly when their hashes match:
+//strings, ints, doubles other than -0.0, which equals 0.0 under a different hash, and bools. Type 6 (null, int64, uint64)
+//is left out as the DP scores any two of those 1 whatever their values
+bool Linus::jsondiff::JsonDiffer::scalar_run(const rapidjson::Value& array, const int* type, unsigned int start, unsigned int end)
+{
+    if (SIMILARITY_THRESHOLD <= 0 || SIMILARITY_THRESHOLD > 1)
+    {
+        return false;
+    }
+    for (unsigned int i = start; i < end; ++i)
+    {
+        if (type[i] <= 1 || type[i] == 6 || (type[i] == 4 && array[i].GetDouble() == 0 && std::signbit(array[i].GetDouble())))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//Hyyro's bit-vector LCS over element hashes, 64 cells of a row per word: bit j of row i is 0 exactly where dp[i][j + 1] = dp[i][j] + 1.
+//With pair_list it keeps every row and walks back the same way LCS does, otherwise only the length is computed
+unsigned int Linus::jsondiff::JsonDiffer::bit_LCS(const std::uint64_t* hash_left, unsigned int sleft, unsigned int eleft, const std::uint64_t* hash_right, unsigned int sright, unsigned int eright, std::map<unsigned int, unsigned int>* pair_list)
+{
+    unsigned int len_left = eleft - sleft;
+    unsigned int len_right = eright - sright;
+    if (len_left == 0 || len_right == 0)
+    {
+        return 0;
+    }
+    unsigned int words = (len_right + 63) / 64;
+    //the alphabet is the sorted distinct right hashes, a symbol is its position in it
+    Linus::jsondiff::Scratch<std::uint64_t> symbols(len_right, 0);
+    std::copy(hash_right + sright, hash_right + eright, symbols.begin());
+    std::sort(symbols.begin(), symbols.end());
+    std::uint64_t* symbols_end = std::unique(symbols.begin(), symbols.end());
+    Linus::jsondiff::Scratch<std::uint64_t> masks((symbols_end - symbols.begin()) * words, 0);
+    for (unsigned int j = 0; j < len_right; ++j)
+    {
+        std::size_t symbol = std::lower_bound(symbols.begin(), symbols_end, hash_right[sright + j]) - symbols.begin();
+        masks[symbol * words + j / 64] |= 1ULL << (j % 64);
+    }
+    Linus::jsondiff::Scratch<std::uint64_t> rows((pair_list ? len_left + 1 : 1) * words, ~0ULL);
+    for (unsigned int i = 1; i <= len_left; ++i)
+    {
+        std::uint64_t* row = &rows[(pair_list ? i : 0) * words];
+        if (pair_list)
+        {
+            std::copy(row - words, row, row);
+        }
+        const std::uint64_t* found = std::lower_bound(symbols.begin(), symbols_end, hash_left[sleft + i - 1]);
+        if (found == symbols_end || *found != hash_left[sleft + i - 1])
+        {
+            continue;
+        }
+        const std::uint64_t* mask = &masks[(found - symbols.begin()) * words];
+        std::uint64_t carry = 0;
+        for (unsigned int w = 0; w < words; ++w)
+        {
+            std::uint64_t v = row[w];
+            std::uint64_t u = v & mask[w];
+            std::uint64_t sum = v + u;
+            std::uint64_t next = sum < v;
+            sum += carry;
+            next |= sum < carry;
+            carry = next;
+            row[w] = sum | (v & ~mask[w]);
+        }
+    }
+    //dp[i][j] counts the zero bits below bit j of row i
+    auto dp = [&](unsigned int i, unsigned int j)
+    {
+        const std::uint64_t* row = &rows[(pair_list ? i : 0) * words];
+        unsigned int ones = 0;
+        for (unsigned int w = 0; w < j / 64; ++w)
+        {
+            ones += __builtin_popcountll(row[w]);
+        }
+        if (j % 64)
+        {
+            ones += __builtin_popcountll(row[j / 64] & ((1ULL << (j % 64)) - 1));
+        }
+        return j - ones;
+    };
+    unsigned int length = dp(len_left, len_right);
+    if (!pair_list)
+    {
+        return length;
+    }
+    auto step = [&](unsigned int i, unsigned int j)
+    {
+        return static_cast<unsigned int>(!((rows[i * words + (j - 1) / 64] >> ((j - 1) % 64)) & 1));
+    };
+    //current is dp[i][j] and up is dp[i - 1][j], moving left only peels one bit off each
+    unsigned int i = len_left;
+    unsigned int j = len_right;
+    unsigned int current = length;
+    unsigned int up = dp(i - 1, j);
+    while (i > 0 && j > 0)
+    {
+        if (hash_left[sleft + i - 1] == hash_right[sright + j - 1])
+        {
+            (*pair_list)[sleft + i - 1] = sright + j - 1;
+            current = up - step(i - 1, j);
+            --i;
+            --j;
+            up = i > 0 ? dp(i - 1, j) : 0;
+        }
+        else if (up > current - step(i, j))
+        {
+            current = up;
+            --i;
+            up = i > 0 ? dp(i - 1, j) : 0;
+        }
+        else
+        {
+            current -= step(i, j);
+            up -= step(i - 1, j);
+            --j;
+        }
+    }
+    return length;
+}
+
+std::map<unsigned int, unsigned int> Linus::jsondiff::JsonDiffer::LCS(Linus::jsondiff::TreeLevel level)
+{
+    unsigned int len_left = level.left.Size();
+    unsigned int len_right = level.right.Size();
+    std::vector<int> type_left(len_left);
+    std::vector<int> type_right(len_right);
+    std::vector<std::uint64_t> hash_left(len_left);
+    std::vector<std::uint64_t> hash_right(len_right);
+    for (unsigned int i = 0; i < len_left; ++i)
+    {
+        type_left[i] =  Linus::jsondiff::JsonDiffer::get_type(level.left[i]);
+        hash_left[i] = Linus::jsondiff::JsonDiffer::get_hash(level.left[i]);
+    }
+    for (unsigned int j = 0; j < len_right; ++j)
+    {
+        type_right[j] = Linus::jsondiff::JsonDiffer::get_type(level.right[j]);
+        hash_right[j] = Linus::jsondiff::JsonDiffer::get_hash(level.right[j]);
+    }
+    return LCS(level, type_left, hash_left, 0, len_left, type_right, hash_right, 0, len_right);
+}
+
+//LCS over left[sleft, eleft) and right[sright, eright), pairs are reported with absolute indices
+std::map<unsigned int, unsigned int> Linus::jsondiff::JsonDiffer::LCS(Linus::jsondiff::TreeLevel level, std::vector<int>& type_left, std::vector<std::uint64_t>& hash_left, unsigned int sleft, unsigned int eleft, std::vector<int>& type_right, std::vector<std::uint64_t>& hash_right, unsigned int sright, unsigned int eright)
+{
+    unsigned int len_left = eleft - sleft;
+    unsigned int len_right = eright - sright;
+    Linus::jsondiff::Stats::count(Linus::jsondiff::Stats::DP_CELLS, static_cast<std::uint64_t>(len_left) * len_right);
+    if (scalar_run(level.left, type_left.data(), sleft, eleft) && scalar_run(level.right, type_right.data(), sright, eright))
+    {
+        std::map<unsigned int, unsigned int> pair_list;
+        bit_LCS(hash_left.data(), sleft, eleft, hash_right.data(), sright, eright, &pair_list);
+        return pair_list;
+    }
+    Linus::jsondiff::Scratch<double> previous(len_right + 1, 0.0);
+    Linus::jsondiff::Scratch<double> current(len_right + 1, 0.0);
+    Linus::jsondiff::DirectionPlane moves(len_left, len_right);
+
+    //auto Lstart = std::chrono::high_resolution_clock::now();
+
+    //auto Lfinish = std::chrono::high_resolution_clock::now();
+    //std::chrono::duration<double> getting_types = Lfinish - Lstart;
+    //if(!drill)    std::cout << "LCS: getting types: " << getting_types.count() << std::endl;
+
+    //Lstart = std::chrono::high_resolution_clock::now();
+
+    for (unsigned int i = 1; i <= len_left; ++i)
+    {
+        for (unsigned int j = 1; j <= len_right; ++j)
+        {
+            double score_;
+            if (hash_left[sleft+i-1] == hash_right[sright+j-1] && level.left[sleft+i-1] == level.right[sright+j-1])
+            {
+                score_ = 1;
+            }
+            else if (type_left[sleft+i-1] == type_right[sright+j-1])
+            {
+                switch (type_left[sleft+i-1])
+                {
+                    case 0:
+                    {
+                        score_ = Linus::jsondiff::JsonDiffer::drill_obj(level.left[sleft+i-1], level.right[sright+j-1], SIMILARITY_THRESHOLD);
+                        break;
+                    }
+                    case 1:
+                    {
+                        score_ = Linus::jsondiff::JsonDiffer::drill_LCS(level.left[sleft+i-1], level.right[sright+j-1], SIMILARITY_THRESHOLD);
+                        break;
+                    }
+                    case 2:
+                        score_ = (std::strcmp(level.left[sleft+i-1].GetString(), level.right[sright+j-1].GetString()) == 0) ? 1 : 0;
+                        break;
+                    case 3:
+                        score_ = (level.left[sleft+i-1].GetInt() == level.right[sright+j-1].GetInt());
+                        break;
+                    case 4:
+                        score_ = (level.left[sleft+i-1].GetDouble() == level.right[sright+j-1].GetDouble());
+                        break;
+                    case 5:
+                        score_ = (level.left[sleft+i-1].GetBool() == level.right[sright+j-1].GetBool());
+                        break;
+                    case 6:
+                        score_ = 1;
+                        break;
+                    default:
+                        score_ = 0;
+                        break;
+                }
+            }
+            else
+            {
+                score_ = 0;
+            }
+            if (score_ >= SIMILARITY_THRESHOLD)
+            {
+                current[j] = previous[j - 1] + score_;
+                moves.set(i - 1, j - 1, Linus::jsondiff::DirectionPlane::DIAGONAL);
+            }
+            else
+            {
+                current[j] = std::max(previous[j], current[j - 1]);
+                moves.set(i - 1, j - 1, previous[j] > current[j - 1] ? Linus::jsondiff::DirectionPlane::UP : Linus::jsondiff::DirectionPlane::LEFT);
+            }
+        }
+        previous.swap(current);
+    }
+
+    //Lfinish = std::chrono::high_resolution_clock::now();
+    //getting_types = Lfinish - Lstart;
+    //if(!drill)    std::cout << "LCS: computing dp table: " << getting_types.count() << std::endl;
+
+    //Lstart = std::chrono::high_resolution_clock::now();
+    //std::cout << "Tace back" << std::endl;
+    std::map<unsigned int, unsigned int> pair_list;
+    unsigned int i = len_left;
+    unsigned int j = len_right;
+    while (i > 0 && j > 0)
+    {
+        unsigned char move = moves.get(i - 1, j - 1);
+        if (move == Linus::jsondiff::DirectionPlane::DIAGONAL)
+        //if ((dp[i][j] - dp[i-1][j-1]) >= SIMILARITY_THRESHOLD && (dp[i][j] - dp[i-1][j-1]) < 1)
+        {
+            pair_list[sleft + i - 1] = sright + j - 1;
+            --i;
+            --j;
+        }
+        else if (move == Linus::jsondiff::DirectionPlane::UP)
+        {
+            --i;
+        }
+        else
+        {
+            --j;
+        }
+    }
+
+    //Lfinish = std::chrono::high_resolution_clock::now();
+    //getting_types = Lfinish - Lstart;
+    //if(!drill)    std::cout << "LCS: retreiving dp table: " << getting_types.count() << std::endl;
+
+    return pair_list;
+}
+
+//a result below cutoff is only an upper bound, callers that compare against SIMILARITY_THRESHOLD pass it so hopeless pairs stop early
+//negative cache entries -1 - bound remember such a bound without passing it off as the exact score
+double Linus::jsondiff::JsonDiffer::drill_LCS(const rapidjson::Value& left, const rapidjson::Value& right, double cutoff)
+{
+    Linus::jsondiff::Stats::count(Linus::jsondiff::Stats::DRILL_CALLS, 1);
+    unsigned int len_left = left.Size();
+    unsigned int len_right = right.Size();
+    if (len_left == 0 && len_right == 0) return 1.0;
+    if (len_left == 0 || len_right == 0) return 0.0;
+    if (same_subtree(left, right)) return 1.0;
+    double cached;
+    if (cache.find(&left, &right, cached))
+    {
+        if (cached >= 0) return cached;
+        if (-1 - cached < cutoff) return -1 - cached;
+    }
+    Linus::jsondiff::Scratch<int> type_left(len_left, 0);
+    Linus::jsondiff::Scratch<int> type_right(len_right, 0);
+    Linus::jsondiff::Scratch<std::uint64_t> hash_left(len_left, 0);
+    Linus::jsondiff::Scratch<std::uint64_t> hash_right(len_right, 0);
+    unsigned int histogram_left[8] = {0};
+    unsigned int histogram_right[8] = {0};
+
+    for (unsigned int i = 0; i < len_left; ++i)
+    {
+        type_left[i] =  Linus::jsondiff::JsonDiffer::get_type(left[i]);
+        hash_left[i] = Linus::jsondiff::JsonDiffer::get_hash(left[i]);
+        ++histogram_left[type_left[i]];
+    }
+    for (unsigned int j = 0; j < len_right; ++j)
+    {
+        type_right[j] = Linus::jsondiff::JsonDiffer::get_type(right[j]);
+        hash_right[j] = Linus::jsondiff::JsonDiffer::get_hash(right[j]);
+        ++histogram_right[type_right[j]];
+    }
+    //only elements of the same type can pair, and each pair adds at most 1
+    double longest = max(len_left, len_right);
+    unsigned int matchable = 0;
+    for (int t = 0; t < 8; ++t)
+    {
+        matchable += std::min(histogram_left[t], histogram_right[t]);
+    }
+    if (matchable / longest + PRUNE_SLACK < cutoff)
+    {
+        cache.insert(&left, &right, -1 - matchable / longest);
+        return matchable / longest;
+    }
+    if (out_of_time())
+    {
+        return 0;
+    }
+    Linus::jsondiff::Stats::count(Linus::jsondiff::Stats::DP_CELLS, static_cast<std::uint64_t>(len_left) * len_right);
+    if (scalar_run(left, type_left.begin(), 0, len_left) && scalar_run(right, type_right.begin(), 0, len_right))
+    {
+        double result = bit_LCS(hash_left.begin(), 0, len_left, hash_right.begin(), 0, len_right, nullptr) / longest;
+        cache.insert(&left, &right, result);
+        return result;
+    }
+    Linus::jsondiff::Scratch<double> previous(len_right + 1, 0.0);
+    Linus::jsondiff::Scratch<double> current(len_right + 1, 0.0);
+    
     for (unsigned int i = 1; i <= len_left; ++i)
     {
-        for (unsigned int j = 1; j <= len_right; ++j)
+        for (unsigned int j = 1; j <= len_right; ++j)
+        {
+            double score_;
+            if (hash_left[i-1] == hash_right[j-1] && left[i-1] == right[j-1])
+            {
+                score_ = 1;
+            }
+            else if (type_left[i-1] == type_right[j-1])
+            {
+                switch (type_left[i-1])
+                {
+                    case 0:
+                    {
+                        score_ = Linus::jsondiff::JsonDiffer::drill_obj(left[i-1], right[j-1], SIMILARITY_THRESHOLD);
+                        break;
+                    }
+                    case 1:
+                    {
+                        score_ = Linus::jsondiff::JsonDiffer::drill_LCS(left[i-1], right[j-1], SIMILARITY_THRESHOLD);
+                        break;
+                    }
+                    case 2:
+                        score_ = (std::strcmp(left[i-1].GetString(), right[j-1].GetString()) == 0) ? 1 : 0;
+                        break;
+                    case 3:
+                        score_ = (left[i-1].GetInt() == right[j-1].GetInt());
+                        break;
+                    case 4:
+                        score_ = (left[i-1].GetDouble() == right[j-1].GetDouble());
+                        break;
+                    case 5:
+                        score_ = (left[i-1].GetBool() == right[j-1].GetBool());
+                        break;
+                    case 6:
+                        score_ = 1;
+                        break;
+                    default:
+                        score_ = 0;
+                        break;
+                }
+            }
+            else
+            {
+                score_ = 0;
+            }
+            if (score_ >= SIMILARITY_THRESHOLD)
+            {
+                current[j] = previous[j - 1] + score_;
+            }
+            else
+            {
+                current[j] = std::max(previous[j], current[j - 1]);
+            }
+        }
+        previous.swap(current);
+        if (cutoff > 0)
+        {
+            //no cell below row i exceeds the best cell of row i by more than the rows left
+            double bound = (*std::max_element(previous.begin(), previous.end()) + len_left - i) / longest;
+            if (bound + PRUNE_SLACK < cutoff)
+            {
+                cache.insert(&left, &right, -1 - bound);
+                return bound;
+            }
+        }
+    }
+    double result = previous[len_right] / max(len_left, len_right);
+    cache.insert(&left, &right, result);
+    return result;
+}
+
+double Linus::jsondiff::JsonDiffer::drill_obj(const rapidjson::Value& left, const rapidjson::Value& right, double cutoff)
+{
+    Linus::jsondiff::Stats::count(Linus::jsondiff::Stats::DRILL_CALLS, 1);
+    if (left.ObjectEmpty() && right.ObjectEmpty()) return 1.0;
+    if (left.ObjectEmpty() || right.ObjectEmpty()) return 0.0;
+    if (same_subtree(left, right)) return 1.0;
+    double cached;
+    if (cache.find(&left, &right, cached))
+    {
+        if (cached >= 0) return cached;
+        if (-1 - cached < cutoff) return -1 - cached;
+    }
+    unsigned int len_left = left.MemberCount();
+    unsigned int len_right = right.MemberCount();
+    //c shared keys score at most c / (len_left + len_right - c)
+    double bound = static_cast<double>(std::min(len_left, len_right)) / std::max(len_left, len_right);
+    if (bound + PRUNE_SLACK < cutoff)
+    {
+        cache.insert(&left, &right, -1 - bound);
+        return bound;
+    }
+    if (out_of_time())
+    {
+        return 0;
+    }
+    auto member_score = [this](const rapidjson::Value& value_left, const rapidjson::Value& value_right, double member_cutoff)
+    {
+        double score_;
+        int type_left = Linus::jsondiff::JsonDiffer::get_type(value_left);
+        int type_right = Linus::jsondiff::JsonDiffer::get_type(value_right);
+        if (type_left == type_right)
+        {
+            switch (type_left)
+            {
+                case 0:
+                {
+                    score_ = Linus::jsondiff::JsonDiffer::drill_obj(value_left, value_right, member_cutoff);
+                    break;
+                }
+                case 1:
+                {
+                    score_ = Linus::jsondiff::JsonDiffer::drill_LCS(value_left, value_right, member_cutoff);
+                    break;
+                }
+                case 2:
+                    score_ = (std::strcmp(value_left.GetString(), value_right.GetString()) == 0) ? 1 : 0;
+                    break;
+                case 3:
+                    score_ = (value_left.GetInt() == value_right.GetInt());
+                    break;
+                case 4:
+                    score_ = (value_left.GetDouble() == value_right.GetDouble());
+                    break;
+                case 5:
+                    score_ = (value_left.GetBool() == value_right.GetBool());
+                    break;
+                case 6:
+                    score_ = 1;
+                    break;
+                default:
+                    score_ = 0;
+                    break;
+            }
+        }
+        else
+        {
+            score_ = 0;
+        }
+        return score_;
+    };
+    double score = 0;
+    unsigned int count = 0;
+    //members not visited yet may each add 1 and share their key, partial sums the scores visited so far
+    double partial = 0;
+    unsigned int rest = len_left;
+    auto upper = [&]()
+    {
+        return (partial + rest) / (len_left + len_right - count - rest);
+    };
+    //scores one shared member, asking it only for what the whole object still needs to reach cutoff;
+    //returns false once the object provably stays below cutoff
+    auto visit = [&](const rapidjson::Value& value_left, const rapidjson::Value& value_right, double& member)
+    {
+        double need = cutoff * (len_left + len_right - count - rest) - partial - (rest - 1) - PRUNE_SLACK;
+        member = member_score(value_left, value_right, need);
+        ++count;
+        --rest;
+        partial += member;
+        return member >= need;
+    };
+    auto below = [&]()
+    {
+        bound = std::min(upper(), std::nextafter(cutoff, 0.0));
+        cache.insert(&left, &right, -1 - bound);
+        return bound;
+    };
+    if (len_right < KEY_INDEX_MIN)
+    {
+        for (auto iter = left.MemberBegin(); iter != left.MemberEnd(); ++iter)
+        {
+            const char* key = iter->name.GetString();
+            auto found = right.FindMember(key);
+            if (found != right.MemberEnd())
+            {
+                double member;
+                if (!visit(iter->value, found->value, member)) return below();
+                score += member;
+            }
+            else
+            {
+                --rest;
+            }
+            if (upper() + PRUNE_SLACK < cutoff) return below();
+        }
+    }
+    else
+    {
+        //merge the sorted key indexes, scores are still summed in left member order
+        Linus::jsondiff::Scratch<const rapidjson::Value::Member*> left_scratch(len_left, nullptr);
+        Linus::jsondiff::Scratch<const rapidjson::Value::Member*> right_scratch(len_right, nullptr);
+        const rapidjson::Value::Member* const* left_keys = key_index(left, left_scratch);
+        const rapidjson::Value::Member* const* right_keys = key_index(right, right_scratch);
+        const rapidjson::Value::Member* first = &*left.MemberBegin();
+        Linus::jsondiff::Scratch<double> scores(len_left, 0.0);
+        unsigned int j = 0;
+        for (unsigned int i = 0; i < len_left; ++i)
+        {
+            while (j < len_right && compare_name(right_keys[j], left_keys[i]) < 0) ++j;
+            if (j < len_right && compare_name(right_keys[j], left_keys[i]) == 0)
+            {
+                if (!visit(left_keys[i]->value, right_keys[j]->value, scores[left_keys[i] - first])) return below();
+            }
+            else
+            {
+                --rest;
+            }
+            if (upper() + PRUNE_SLACK < cutoff) return below();
+        }
+        for (unsigned int i = 0; i < scores.size(); ++i)
+        {
+            score += scores[i];
+        }
+    }
+    double result = score / (len_left + len_right - count);
+    cache.insert(&left, &right, result);
+    return result;
+}
+
+//writes the last row, len_right + 2 scores, into score
+void Linus::jsondiff::JsonDiffer::NWScore(bool reverse, Linus::jsondiff::TreeLevel level, bool drill, std::vector<int>& type_left, std::vector<std::uint64_t>& hash_left, unsigned int sleft, unsigned int eleft, std::vector<int>& type_right, std::vector<std::uint64_t>& hash_right, unsigned int sright, unsigned int eright, double* score)
+{
+    //if (reverse) std::cout << "Reverse ";
+    //std::cout << "NWScore sleft " << sleft << " eleft " << eleft << " sright " << sright << " eright " << eright << std::endl;
+    unsigned int len_left = eleft - sleft + 1;
+    unsigned int len_right = eright - sright + 1;
+    Linus::jsondiff::Stats::count(Linus::jsondiff::Stats::DP_CELLS, static_cast<std::uint64_t>(len_left) * len_right);
+    Linus::jsondiff::Scratch<double> previous(len_right + 1, 0);
+    Linus::jsondiff::Scratch<double> current(len_right + 1, 0);
+    if (reverse)
+    {
+        for (int i = 1; i <= len_left; ++i)
+        {
+            current[0] = previous[0];
+            for (int j = 1; j <= len_right; ++j)
+            {
+                //std::cout << "left index " << eleft+1-i << " right " << eright+1-j << std::endl;
+                double score_;
+                if (hash_left[eleft + 1 - i] == hash_right[eright + 1 - j] && level.left[eleft + 1 - i] == level.right[eright + 1 - j])
+                {
+                    score_ = 1;
+                }
+                else if (type_left[eleft + 1 - i] == type_right[eright + 1 - j])
+                {
+                    switch (type_left[eleft + 1 - i])
+                    {
+                        case 0:
+                        {
+                            //Linus::jsondiff::TreeLevel level_(level.left[eleft + 1 - i], level.right[eright + 1 - j]);
+                            //score_ = Linus::jsondiff::JsonDiffer::compare_object(level_, true);
+                            score_ = Linus::jsondiff::JsonDiffer::drill_obj(level.left[eleft+1-i], level.right[eright+1-j], 0.0);
+                            break;
+                        }
+                        case 1:
+                        {
+                            //Linus::jsondiff::TreeLevel level_(level.left[eleft + 1 - i], level.right[eright + 1 - j]);
+                            //score_ = Linus::jsondiff::JsonDiffer::compare_array(level_, true);
+                            score_ = Linus::jsondiff::JsonDiffer::drill_LCS(level.left[eleft+1-i], level.right[eright+1-j], 0.0);
+                            break;
+                        }
+                        case 2:
+                            score_ = (std::strcmp(level.left[eleft+1-i].GetString(), level.right[eright+1-j].GetString()) == 0);
+                            break;
+                        case 3:
+                            score_ = (level.left[eleft+1-i].GetInt() == level.right[eright+1-j].GetInt());
+                            break;
+                        case 4:
+                            score_ = (level.left[eleft+1-i].GetDouble() == level.right[eright+1-j].GetDouble());
+                            break;
+                        case 5:
+                            score_ = (level.left[eleft+1-i].GetBool() == level.right[eright+1-j].GetBool());
+                            break;
+                        case 6:
+                            score_ = 1;
+                            break;
+                        default:
+                            score_ = 0;
+                            break;
+                    }
+                }
+                else
+                {
+                    score_ = 0;
+                }
+                current[j] = std::max(previous[j - 1] + score_, std::max(previous[j], current[j - 1]));
+            }
+            previous.swap(current);
+        }
+    }
+    else
+    {
+        for (int i = 1; i <= len_left; ++i)
+        {
+            current[0] = previous[0];
+            for (int j = 1; j <= len_right; ++j)
+            {
+                double score_;
+                if (hash_left[sleft + i - 1] == hash_right[sright + j - 1] && level.left[sleft + i - 1] == level.right[sright + j - 1])
+                {
+                    score_ = 1;
+                }
+                else if (type_left[sleft + i - 1] == type_right[sright + j - 1])
+                {
+                    switch (type_left[sleft + i - 1])
+                    {
+                        case 0:
+                        {
+                            //Linus::jsondiff::TreeLevel level_(level.left[sleft + i - 1], level.right[sright + j - 1]);
+                            //Linus::jsondiff::TreeLevel level_(level.left[1], level.right[23]);
+                            //score_ = Linus::jsondiff::JsonDiffer::compare_object(level_, true);
+                            score_ = Linus::jsondiff::JsonDiffer::drill_obj(level.left[sleft+i-1], level.right[sright+j-1], 0.0);
+                            break;
+                        }
+                        case 1:
+                        {
+                            //Linus::jsondiff::TreeLevel level_(level.left[sleft + i - 1], level.right[sright + j - 1]);
+                            //score_ = Linus::jsondiff::JsonDiffer::compare_array(level_, true);
+                            score_ = Linus::jsondiff::JsonDiffer::drill_LCS(level.left[sleft+i-1], level.right[sright+j-1], 0.0);
+                            break;
+                        }
+                        case 2:
+                            score_ = (std::strcmp(level.left[sleft+i-1].GetString(), level.right[sright+j-1].GetString()) == 0);
+                            break;
+                        case 3:
+                            score_ = (level.left[sleft+i-1].GetInt() == level.right[sright+j-1].GetInt());
+                            break;
+                        case 4:
+                            score_ = (level.left[sleft+i-1].GetDouble() == level.right[sright+j-1].GetDouble());
+                            break;
+                        case 5:
+                            score_ = (level.left[sleft+i-1].GetBool() == level.right[sright+j-1].GetBool());
+                            break;
+                        case 6:
+                            score_ = 1;
+                            break;
+                        default:
+                            score_ = 0;
+                            break;
+                    }
+                }
+                else
+                {
+                    score_ = 0;
+                }
+                current[j] = std::max(previous[j - 1] + score_, std::max(previous[j], current[j - 1]));
+            }
+            previous.swap(current);
+        }
+    }
+    std::copy(previous.begin(), previous.end(), score);
+}
+
+std::map<unsigned int, unsigned int> Linus::jsondiff::JsonDiffer::Hirschberg(Linus::jsondiff::TreeLevel level, bool drill, std::vector<int>& type_left, std::vector<std::uint64_t>& hash_left, unsigned int sleft, unsigned int eleft, std::vector<int>& type_right, std::vector<std::uint64_t>& hash_right, unsigned int sright, unsigned int eright)
+{
+    std::map<unsigned int, unsigned int> pair_list;
+    if (eleft + 1 <= sleft || eright + 1 <= sright)
+    {
+        return pair_list;
+    }
+    //matches[i - sleft] is the right index paired with left i, or -1
+    std::vector<int> matches(eleft - sleft + 1, -1);
+    Hirschberg_split(level, drill, type_left, hash_left, sleft, eleft, type_right, hash_right, sright, eright, matches, sleft);
+    for (unsigned int i = 0; i < matches.size(); ++i)
+    {
+        if (matches[i] != -1)
+        {
+            pair_list.emplace_hint(pair_list.end(), sleft + i, matches[i]);
+        }
+    }
+    return pair_list;
+}
+
+//ends are inclusive; subproblems of at most HIRSCHBERG_CELLS cells, or one row or column, are solved by the plain LCS
+void Linus::jsondiff::JsonDiffer::Hirschberg_split(Linus::jsondiff::TreeLevel& level, bool drill, std::vector<int>& type_left, std::vector<std::uint64_t>& hash_left, unsigned int sleft, unsigned int eleft, std::vector<int>& type_right, std::vector<std::uint64_t>& hash_right, unsigned int sright, unsigned int eright, std::vector<int>& matches, unsigned int first)
+{
+    //std::cout << "Hirschberg sleft " << sleft << " eleft " << eleft << " sright " << sright << " eright " << eright << std::endl;
+    if (eleft + 1 <= sleft || eright + 1 <= sright)
+    {
+        return;
+    }
+    unsigned int len_left = eleft - sleft + 1;
+    //std::cout << "len_left " << len_left << std::endl;
+    unsigned int len_right = eright - sright + 1;
+    if (len_left == 1 || len_right == 1 || static_cast<std::uint64_t>(len_left) * len_right <= HIRSCHBERG_CELLS)
+    {
+        for (const auto& pair : LCS(level, type_left, hash_left, sleft, eleft + 1, type_right, hash_right, sright, eright + 1))
+        {
+            matches[pair.first - first] = pair.second;
+        }
+        return;
+    }
+    unsigned int left_mid = (sleft + eleft) / 2;
+    //std::cout << "left_mid " << left_mid << std::endl;
+    //both passes and both halves are independent, big enough subproblems run them as tasks in the differ's arena
+    bool parallel = num_thread > 1 && static_cast<std::uint64_t>(len_left) * len_right >= PARALLEL_CELLS;
+    Linus::jsondiff::Scratch<double> scoreL(len_right + 1, 0.0);
+    Linus::jsondiff::Scratch<double> scoreR(len_right + 1, 0.0);
+    if (parallel)
+    {
+        tbb::task_group group;
+        group.run([&] { NWScore(false, level, true, type_left, hash_left, sleft, left_mid, type_right, hash_right, sright, eright, scoreL.begin()); });
+        NWScore(true, level, true, type_left, hash_left, left_mid + 1, eleft, type_right, hash_right, sright, eright, scoreR.begin());
+        group.wait();
+    }
+    else
+    {
+        NWScore(false, level, true, type_left, hash_left, sleft, left_mid, type_right, hash_right, sright, eright, scoreL.begin());
+        NWScore(true, level, true, type_left, hash_left, left_mid + 1, eleft, type_right, hash_right, sright, eright, scoreR.begin());
+    }
+    //both passes fill one cell per split point, so once scoreR is reversed scoreL[i] + scoreR[i] scores giving the upper
+    //half the right elements before sright + i; an empty half ends at sright - 1 or starts at eright + 1, which the check
+    //on entry returns from
+    std::reverse(scoreR.begin(), scoreR.end());
+    unsigned int right_mid;
+    double max = -1;
+    for (unsigned int i = 0; i < scoreL.size(); ++i)
+    {
+        double score_ = scoreL[i] + scoreR[i];
+        if (score_ > max)
+        {
+            max = score_;
+            right_mid = sright + i;
+        }
+    }
+    //std::cout << "right_mid " << right_mid << std::endl;
+    //the halves own disjoint left ranges, so they fill their slots of matches without any merging
+    if (parallel)
+    {
+        tbb::task_group group;
+        group.run([&] { Hirschberg_split(level, drill, type_left, hash_left, sleft, left_mid, type_right, hash_right, sright, right_mid - 1, matches, first); });
+        Hirschberg_split(level, drill, type_left, hash_left, left_mid + 1, eleft, type_right, hash_right, right_mid, eright, matches, first);
+        group.wait();
+    }
+    else
+    {
+        Hirschberg_split(level, drill, type_left, hash_left, sleft, left_mid, type_right, hash_right, sright, right_mid - 1, matches, first);
+        Hirschberg_split(level, drill, type_left, hash_left, left_mid + 1, eleft, type_right, hash_right, right_mid, eright, matches, first);
+    }
+}
+
+std::map<unsigned int, unsigned int> Linus::jsondiff::JsonDiffer::Hirschberg_starter(Linus::jsondiff::TreeLevel level)
+{
+    unsigned int len_left = level.left.Size();
+    unsigned int len_right = level.right.Size();
+    std::vector<int> type_left(len_left);
+    std::vector<int> type_right(len_right);
+    std::vector<std::uint64_t> hash_left(len_left);
+    std::vector<std::uint64_t> hash_right(len_right);
+    for (unsigned int i = 0; i < len_left; ++i)
+    {
+        type_left[i] =  Linus::jsondiff::JsonDiffer::get_type(level.left[i]);
+        hash_left[i] = Linus::jsondiff::JsonDiffer::get_hash(level.left[i]);
+    }
+    for (unsigned int j = 0; j < len_right; ++j)
+    {
+        type_right[j] = Linus::jsondiff::JsonDiffer::get_type(level.right[j]);
+        hash_right[j] = Linus::jsondiff::JsonDiffer::get_hash(level.right[j]);
+    }
+    return Hirschberg(level, true, type_left, hash_left, 0, len_left-1, type_right, hash_right, 0, len_right-1);
+}
+
+//patience style pre-stage: equal prefix and suffix are paired directly, then elements occurring exactly once
+//on both sides are used as anchors and only the gaps between them go through the similarity DP. Returns the weakest
+//match gap_match left any of the gaps, FULL_MATCH when none was cut short
+int Linus::jsondiff::JsonDiffer::anchor_gap(Linus::jsondiff::TreeLevel level, std::vector<int>& type_left, std::vector<std::uint64_t>& hash_left, unsigned int sleft, unsigned int eleft, std::vector<int>& type_right, std::vector<std::uint64_t>& hash_right, unsigned int sright, unsigned int eright, std::map<unsigned int, unsigned int>& pair_list)
+{
+    while (sleft < eleft && sright < eright && hash_left[sleft] == hash_right[sright] && same_subtree(level.left[sleft], level.right[sright]))
+    {
+        pair_list[sleft] = sright;
+        ++sleft;
+        ++sright;
+    }
+    while (sleft < eleft && sright < eright && hash_left[eleft - 1] == hash_right[eright - 1] && same_subtree(level.left[eleft - 1], level.right[eright - 1]))
+    {
+        pair_list[eleft - 1] = eright - 1;
+        --eleft;
+        --eright;
+    }
+    if (sleft == eleft || sright == eright)
+    {
+        return FULL_MATCH;
+    }
+
+    struct Occurrence
+    {
+        unsigned int count_left;
+        unsigned int count_right;
+        unsigned int index_left;
+        unsigned int index_right;
+    };
+    std::unordered_map<std::uint64_t, Occurrence> occurrences;
+    for (unsigned int i = sleft; i < eleft; ++i)
+    {
+        Occurrence& occurrence = occurrences.emplace(hash_left[i], Occurrence{0, 0, 0, 0}).first->second;
+        ++occurrence.count_left;
+        occurrence.index_left = i;
+    }
+    for (unsigned int j = sright; j < eright; ++j)
+    {
+        auto iter = occurrences.find(hash_right[j]);
+        if (iter != occurrences.end())
+        {
+            ++iter->second.count_right;
+            iter->second.index_right = j;
+        }
+    }
+    std::vector<std::pair<unsigned int, unsigned int>> candidates;
+    for (const auto& item : occurrences)
+    {
+        const Occurrence& occurrence = item.second;
+        if (occurrence.count_left == 1 && occurrence.count_right == 1 && same_subtree(level.left[occurrence.index_left], level.right[occurrence.index_right]))
+        {
+            candidates.push_back(std::make_pair(occurrence.index_left, occurrence.index_right));
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    //longest increasing run of right indices by patience sorting
+    std::vector<unsigned int> tails;
+    std::vector<int> previous(candidates.size(), -1);
+    for (unsigned int k = 0; k < candidates.size(); ++k)
+    {
+        auto pos = std::lower_bound(tails.begin(), tails.end(), candidates[k].second, [&candidates](unsigned int index, unsigned int value) { return candidates[index].second < value; });
+        if (pos != tails.begin())
+        {
+            previous[k] = *(pos - 1);
+        }
+        if (pos == tails.end())
+        {
+            tails.push_back(k);
+        }
+        else
+        {
+            *pos = k;
+        }
+    }
+    std::vector<std::pair<unsigned int, unsigned int>> anchors;
+    for (int k = tails.empty() ? -1 : tails.back(); k != -1; k = previous[k])
+    {
+        anchors.push_back(candidates[k]);
+    }
+    std::reverse(anchors.begin(), anchors.end());
+
+    if (anchors.empty())
+    {
+        int match = gap_match(level, static_cast<std::uint64_t>(eleft - sleft) * (eright - sright));
+        if (match != FULL_MATCH)
+        {
+            if (match == HASH_MATCH && (hirscheburg || !Myers(hash_left, sleft, eleft, hash_right, sright, eright, pair_list)))
+            {
+                Myers_linear(hash_left, sleft, eleft, hash_right, sright, eright, pair_list);
+            }
+            pair_gaps(pair_list, sleft, eleft, sright, eright);
+            return match;
+        }
+        //with exact equality as the only way to pair, the weighted DP is a plain LCS and Myers finds it in O((N+M)D)
+        bool primitives_only = true;
+        for (unsigned int i = sleft; i < eleft && primitives_only; ++i)
+        {
+            primitives_only = type_left[i] > 1;
+        }
+        for (unsigned int j = sright; j < eright && primitives_only; ++j)
+        {
+            primitives_only = type_right[j] > 1;
+        }
+        if (myers && (SIMILARITY_THRESHOLD >= 1.0 || primitives_only))
+        {
+            if (hirscheburg || !Myers(hash_left, sleft, eleft, hash_right, sright, eright, pair_list))
+            {
+                Myers_linear(hash_left, sleft, eleft, hash_right, sright, eright, pair_list);
+            }
+            return match;
+        }
+        std::map<unsigned int, unsigned int> gap_pairs;
+        if (lsh_bands != 0 && static_cast<std::uint64_t>(eleft - sleft) * (eright - sright) >= PARALLEL_CELLS)
+        {
+            gap_pairs = minhash_LCS(level, type_left, hash_left, sleft, eleft, type_right, hash_right, sright, eright);
+        }
+        else if (band != 0)
+        {
+            gap_pairs = banded_LCS(level, type_left, hash_left, sleft, eleft, type_right, hash_right, sright, eright);
+        }
+        else if (hirscheburg)
+        {
+            gap_pairs = Hirschberg(level, true, type_left, hash_left, sleft, eleft - 1, type_right, hash_right, sright, eright - 1);
+        }
+        else if (num_thread > 1 && static_cast<std::uint64_t>(eleft - sleft) * (eright - sright) >= PARALLEL_CELLS)
+        {
+            gap_pairs = parallel_LCS(level, type_left, hash_left, sleft, eleft, type_right, hash_right, sright, eright);
+        }
+        else
+        {
+            gap_pairs = LCS(level, type_left, hash_left, sleft, eleft, type_right, hash_right, sright, eright);
+        }
+        pair_list.insert(gap_pairs.begin(), gap_pairs.end());
+        return match;
+    }
+    int match = FULL_MATCH;
+    for (const auto& anchor : anchors)
+    {
+        match = std::max(match, anchor_gap(level, type_left, hash_left, sleft, anchor.first, type_right, hash_right, sright, anchor.second, pair_list));
+        pair_list[anchor.first] = anchor.second;
+        sleft = anchor.first + 1;
+        sright = anchor.second + 1;
+    }
+    return std::max(match, anchor_gap(level, type_left, hash_left, sleft, eleft, type_right, hash_right, sright, eright, pair_list));
+}
+
+//one permutation MinHash of an element's shingles: member keys and key/value digests for objects, element digests for arrays,
+//the digest itself for anything else. Each shingle lands in one of length bins and empty bins borrow from the next filled one
+std::vector<std::uint64_t> Linus::jsondiff::JsonDiffer::minhash(const rapidjson::Value& input, std::uint64_t hash, unsigned int length)
+{
+    std::vector<std::uint64_t> signature(length, std::numeric_limits<std::uint64_t>::max());
+    auto add = [&](std::uint64_t shingle)
+    {
+        std::uint64_t value = mix_hash(shingle);
+        std::uint64_t& bin = signature[value % length];
+        bin = std::min(bin, value);
+    };
+    if (input.IsObject() && !input.ObjectEmpty())
+    {
+        for (auto iter = input.MemberBegin(); iter != input.MemberEnd(); ++iter)
+        {
+            std::uint64_t key = hash_bytes(iter->name.GetString(), iter->name.GetStringLength());
+            add(key);
+            add(key ^ (get_hash(iter->value) * 31));
+        }
+    }
+    else if (input.IsArray() && !input.Empty())
+    {
+        for (unsigned int i = 0; i < input.Size(); ++i)
+        {
+            add(get_hash(input[i]));
+        }
+    }
+    else
+    {
+        add(hash);
+    }
+    unsigned int filled = 0;
+    while (signature[filled] == std::numeric_limits<std::uint64_t>::max())
+    {
+        ++filled;
+    }
+    for (unsigned int t = length; t-- > 0;)
+    {
+        if (signature[t] == std::numeric_limits<std::uint64_t>::max())
+        {
+            signature[t] = mix_hash(signature[filled] + t);
+        }
+        else
+        {
+            filled = t;
+        }
+    }
+    return signature;
+}
+
+//LCS over the pairs that share a MinHash band, every other cell counts as 0. lsh_bands bands of lsh_rows values each make a pair
+//with key/value Jaccard similarity J a candidate with probability 1 - (1 - J^lsh_rows)^lsh_bands. The weighted DP over the
+//candidates is a heaviest increasing chain, found with a max Fenwick tree over right indices in O(K log M) for K candidates
+std::map<unsigned int, unsigned int> Linus::jsondiff::JsonDiffer::minhash_LCS(Linus::jsondiff::TreeLevel& level, std::vector<int>& type_left, std::vector<std::uint64_t>& hash_left, unsigned int sleft, unsigned int eleft, std::vector<int>& type_right, std::vector<std::uint64_t>& hash_right, unsigned int sright, unsigned int eright)
+{
+    std::map<unsigned int, unsigned int> pair_list;
+    unsigned int len_left = eleft - sleft;
+    unsigned int len_right = eright - sright;
+    unsigned int rows = std::max(1u, lsh_rows);
+    unsigned int length = lsh_bands * rows;
+    std::vector<std::vector<std::uint64_t>> signature_left(len_left);
+    std::vector<std::vector<std::uint64_t>> signature_right(len_right);
+    tbb::parallel_for(0u, len_left + len_right, [&](unsigned int k)
+    {
+        if (k < len_left)
+        {
+            signature_left[k] = minhash(level.left[sleft + k], hash_left[sleft + k], length);
+        }
+        else
+        {
+            signature_right[k - len_left] = minhash(level.right[sright + k - len_left], hash_right[sright + k - len_left], length);
+        }
+    });
+    auto band_key = [&](const std::vector<std::uint64_t>& signature, unsigned int b)
+    {
+        std::uint64_t key = b;
+        for (unsigned int r = 0; r < rows; ++r)
+        {
+            key = mix_hash(key * 31 + signature[b * rows + r]);
+        }
+        return key;
+    };
+
+    std::vector<std::pair<unsigned int, unsigned int>> candidates;
+    std::vector<std::pair<std::uint64_t, unsigned int>> buckets(len_left);
+    for (unsigned int b = 0; b < lsh_bands; ++b)
+    {
+        for (unsigned int i = 0; i < len_left; ++i)
+        {
+            buckets[i] = std::make_pair(band_key(signature_left[i], b), i);
+        }
+        std::sort(buckets.begin(), buckets.end());
+        for (unsigned int j = 0; j < len_right; ++j)
         {
-            double score_;
-            if (type_left[i-1] == type_right[j-1])
-            {
-                switch (type_left[i-1])
-                {
-                    case 0:
-                    {
-                        score_ = Linus::jsondiff::JsonDiffer::drill_obj(level.left[i-1], level.right[j-1]);
-                        break;
-                    }
-                    case 1:
-                    {
-                        score_ = Linus::jsondiff::JsonDiffer::drill_LCS(level.left[i-1], level.right[j-1]);
-                        break;
-                    }
-                    case 2:
-                        score_ = (std::strcmp(level.left[i-1].GetString(), level.right[j-1].GetString()) == 0) ? 1 : 0;
-                        break;
-                    case 3:
-                        score_ = (level.left[i-1].GetInt() == level.right[j-1].GetInt());
-                        break;
-                    case 4:
-                        score_ = (level.left[i-1].GetDouble() == level.right[j-1].GetDouble());
-                        break;
-                    case 5:
-                        score_ = (level.left[i-1].GetBool() == level.right[j-1].GetBool());
-                        break;
-                    case 6:
-                        score_ = 1;
-                        break;
-                    default:
-                        score_ = 0;
-                        break;
-                }
-            }
-            else
-            {
-                score_ = 0;
-            }
-            if (score_ >= SIMILARITY_THRESHOLD)
+            std::uint64_t key = band_key(signature_right[j], b);
+            auto first = std::lower_bound(buckets.begin(), buckets.end(), std::make_pair(key, 0u));
+            auto last = std::lower_bound(first, buckets.end(), std::make_pair(key, len_left));
+            //crowded buckets, e.g. runs of identical elements, only offer the entries nearest to j's relative position
+            unsigned int expected = static_cast<unsigned int>(static_cast<std::uint64_t>(j) * len_left / len_right);
+            auto middle = std::lower_bound(first, last, std::make_pair(key, expected));
+            auto from = middle - std::min<std::ptrdiff_t>(middle - first, LSH_BUCKET_MAX / 2);
+            auto to = from + std::min<std::ptrdiff_t>(last - from, LSH_BUCKET_MAX);
+            from = to - std::min<std::ptrdiff_t>(to - first, LSH_BUCKET_MAX);
+            for (auto iter = from; iter != to; ++iter)
             {
-                dp[i][j] = dp[i - 1][j - 1] + score_;
+                candidates.push_back(std::make_pair(iter->second, j));
             }
-            else
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    std::vector<double> scores(candidates.size());
+    tbb::parallel_for(std::size_t(0), candidates.size(), [&](std::size_t k)
+    {
+        unsigned int li = sleft + candidates[k].first;
+        unsigned int rj = sright + candidates[k].second;
+        scores[k] = pair_score(level.left[li], level.right[rj], type_left[li], type_right[rj], hash_left[li], hash_right[rj]);
+    });
+
+    //best[p] keeps the heaviest chain ending at a right index in the Fenwick range of p
+    std::vector<std::pair<double, int>> best(len_right + 1, std::make_pair(0.0, -1));
+    std::vector<int> previous(candidates.size(), -1);
+    auto query = [&](unsigned int p)
+    {
+        std::pair<double, int> result(0.0, -1);
+        for (; p > 0; p -= p & (~p + 1))
+        {
+            if (best[p].first > result.first) result = best[p];
+        }
+        return result;
+    };
+    std::vector<double> total(candidates.size(), 0.0);
+    for (std::size_t k = 0; k < candidates.size();)
+    {
+        std::size_t end = k;
+        while (end < candidates.size() && candidates[end].first == candidates[k].first) ++end;
+        //right indices of one left element go in descending order so none of them chains onto another
+        for (std::size_t c = end; c-- > k;)
+        {
+            if (scores[c] < SIMILARITY_THRESHOLD) continue;
+            std::pair<double, int> before = query(candidates[c].second);
+            total[c] = before.first + scores[c];
+            previous[c] = before.second;
+            for (unsigned int p = candidates[c].second + 1; p <= len_right; p += p & (~p + 1))
             {
-                dp[i][j] = std::max(dp[i - 1][j], dp[i][j - 1]);
+                if (total[c] > best[p].first) best[p] = std::make_pair(total[c], static_cast<int>(c));
             }
         }
+        k = end;
     }
+    for (int c = query(len_right).second; c != -1; c = previous[c])
+    {
+        pair_list[sleft + candidates[c].first] = sright + candidates[c].second;
+    }
+    return pair_list;
+}
 
-    //Lfinish = std::chrono::high_resolution_clock::now();
-    //getting_types = Lfinish - Lstart;
-    //if(!drill)    std::cout << "LCS: computing dp table: " << getting_types.count() << std::endl;
-
-    //Lstart = std::chrono::high_resolution_clock::now();
-    //std::cout << "Tace back" << std::endl;
+//LCS restricted to cells within k of the diagonal of left[sleft, eleft) x right[sright, eright)
+//band > 0 uses k = band as is, band < 0 starts at INITIAL_BAND and doubles k until no path leaving the band can beat the banded result;
+//past max_band it gives up and pairs the gap index-wise like compare_array_fast
+std::map<unsigned int, unsigned int> Linus::jsondiff::JsonDiffer::banded_LCS(Linus::jsondiff::TreeLevel& level, std::vector<int>& type_left, std::vector<std::uint64_t>& hash_left, unsigned int sleft, unsigned int eleft, std::vector<int>& type_right, std::vector<std::uint64_t>& hash_right, unsigned int sright, unsigned int eright)
+{
     std::map<unsigned int, unsigned int> pair_list;
-    unsigned int i = len_left;
-    unsigned int j = len_right;
-    while (i > 0 && j > 0)
+    long long len_left = eleft - sleft;
+    long long len_right = eright - sright;
+    if (len_left == 0 || len_right == 0)
     {
-        double score_;
-        if (type_left[i-1] == type_right[j-1])
+        return pair_list;
+    }
+    bool adaptive = band < 0;
+    long long k = adaptive ? INITIAL_BAND : band;
+    while (true)
+    {
+        long long lo = std::max(std::min(0LL, len_right - len_left) - k, -len_left);
+        long long hi = std::min(std::max(0LL, len_right - len_left) + k, len_right);
+        long long width = hi - lo + 1;
+        //row i keeps cell (i, j) at j - i - lo, anything outside the band reads as unreachable
+        Linus::jsondiff::Scratch<double> previous(width, -1.0);
+        Linus::jsondiff::Scratch<double> current(width, -1.0);
+        Linus::jsondiff::DirectionPlane moves(len_left, width);
+        Linus::jsondiff::Stats::count(Linus::jsondiff::Stats::DP_CELLS, static_cast<std::uint64_t>(len_left) * width);
+        for (long long j = 0; j <= std::min(len_right, hi); ++j)
         {
-            switch (type_left[i-1])
+            previous[j - lo] = 0;
+        }
+        for (long long i = 1; i <= len_left; ++i)
+        {
+            std::fill(current.begin(), current.end(), -1.0);
+            for (long long j = std::max(0LL, i + lo); j <= std::min(len_right, i + hi); ++j)
             {
-                case 0:
+                long long diag = j - i - lo;
+                if (j == 0)
                 {
-                    score_ = Linus::jsondiff::JsonDiffer::drill_obj(level.left[i-1], level.right[j-1]);
-                    break;
+                    current[diag] = 0;
+                    continue;
                 }
-                case 1:
+                double up = diag + 1 < width ? previous[diag + 1] : -1.0;
+                double left_ = diag > 0 ? current[diag - 1] : -1.0;
+                unsigned int li = sleft + i - 1;
+                unsigned int rj = sright + j - 1;
+                double score_ = pair_score(level.left[li], level.right[rj], type_left[li], type_right[rj], hash_left[li], hash_right[rj]);
+                if (score_ >= SIMILARITY_THRESHOLD)
                 {
-                    score_ = Linus::jsondiff::JsonDiffer::drill_LCS(level.left[i-1], level.right[j-1]);
-                    break;
+                    current[diag] = previous[diag] + score_;
+                    moves.set(i - 1, diag, Linus::jsondiff::DirectionPlane::DIAGONAL);
+                }
+                else
+                {
+                    current[diag] = std::max(up, left_);
+                    moves.set(i - 1, diag, up > left_ ? Linus::jsondiff::DirectionPlane::UP : Linus::jsondiff::DirectionPlane::LEFT);
                 }
-                case 2:
-                    score_ = (std::strcmp(level.left[i - 1].GetString(), level.right[j - 1].GetString()) == 0) ? 1 : 0;
-                    break;
-                case 3:
-                    score_ = (level.left[i - 1].GetInt() == level.right[j - 1].GetInt());
-                    break;
-                case 4:
-                    score_ = (level.left[i - 1].GetDouble() == level.right[j - 1].GetDouble());
-                    break;
-                case 5:
-                    score_ = (level.left[i - 1].GetBool() == level.right[j - 1].GetBool());
-                    break;
-                case 6:
-                    score_ = 1;
-                    break;
-                default:
-                    score_ = 0;
-                    break;
             }
+            previous.swap(current);
         }
-        else
-        {
-            score_ = 0;
-        }
-        if (score_ >= SIMILARITY_THRESHOLD)
-        //if ((dp[i][j] - dp[i-1][j-1]) >= SIMILARITY_THRESHOLD && (dp[i][j] - dp[i-1][j-1]) < 1)
-        {
-            pair_list[i - 1] = j - 1;
-            --i;
-            --j;
-        }
-        else if (dp[i - 1][j] > dp[i][j - 1])
+        //leaving the band takes more than hi steps right or -lo steps down, and every pair adds at most 1
+        double bound = static_cast<double>(std::max(len_right - hi - 1, len_left + lo - 1));
+        if (!adaptive || previous[len_right - len_left - lo] >= bound)
         {
-            --i;
+            long long i = len_left;
+            long long j = len_right;
+            while (i > 0 && j > 0)
+            {
+                unsigned char move = moves.get(i - 1, j - i - lo);
+                if (move == Linus::jsondiff::DirectionPlane::DIAGONAL)
+                {
+                    pair_list[sleft + i - 1] = sright + j - 1;
+                    --i;
+                    --j;
+                }
+                else if (move == Linus::jsondiff::DirectionPlane::UP)
+                {
+                    --i;
+                }
+                else
+                {
+                    --j;
+                }
+            }
+            return pair_list;
         }
-        else
+        k *= 2;
+        if (k > max_band)
         {
-            --j;
+            break;
         }
     }
-
-    //Lfinish = std::chrono::high_resolution_clock::now();
-    //getting_types = Lfinish - Lstart;
-    //if(!drill)    std::cout << "LCS: retreiving dp table: " << getting_types.count() << std::endl;
-
+    for (long long t = 0; t < std::min(len_left, len_right); ++t)
+    {
+        pair_list[sleft + t] = sright + t;
+    }
     return pair_list;
 }
 
-double Linus::jsondiff::JsonDiffer::drill_LCS(const rapidjson::Value& left, const rapidjson::Value& right)
+std::map<unsigned int, unsigned int> Linus::jsondiff::JsonDiffer::anchored_LCS(Linus::jsondiff::TreeLevel level, int& match)
 {
-    unsigned int len_left = left.Size();
-    unsigned int len_right = right.Size();
+    unsigned int len_left = level.left.Size();
+    unsigned int len_right = level.right.Size();
     std::vector<int> type_left(len_left);
     std::vector<int> type_right(len_right);
-    if (len_left == 0 && len_right == 0) return 1.0;
-    if (len_left == 0 || len_right == 0) return 0.0;
-    std::vector<std::vector<double>> dp(len_left + 1, std::vector<double>(len_right + 1, 0.0));
-
+    std::vector<std::uint64_t> hash_left(len_left);
+    std::vector<std::uint64_t> hash_right(len_right);
     for (unsigned int i = 0; i < len_left; ++i)
     {
-        type_left[i] =  Linus::jsondiff::JsonDiffer::get_type(left[i]);
+        type_left[i] =  Linus::jsondiff::JsonDiffer::get_type(level.left[i]);
+        hash_left[i] = Linus::jsondiff::JsonDiffer::element_hash(level.left[i], type_left[i]);
     }
     for (unsigned int j = 0; j < len_right; ++j)
     {
-        type_right[j] = Linus::jsondiff::JsonDiffer::get_type(right[j]);
+        type_right[j] = Linus::jsondiff::JsonDiffer::get_type(level.right[j]);
+        hash_right[j] = Linus::jsondiff::JsonDiffer::element_hash(level.right[j], type_right[j]);
     }
-    
-    for (unsigned int i = 1; i <= len_left; ++i)
+    std::map<unsigned int, unsigned int> pair_list;
+    match = anchor_gap(level, type_left, hash_left, 0, len_left, type_right, hash_right, 0, len_right, pair_list);
+    return pair_list;
+}
+
+//"auto" detects a unique field per array, anything else is a member path like "id" or "meta/id"
+void Linus::jsondiff::JsonDiffer::set_match_key(const std::string& path)
+{
+    match_key.clear();
+    auto_match_key = path == "auto";
+    if (auto_match_key)
     {
-        for (unsigned int j = 1; j <= len_right; ++j)
+        return;
+    }
+    std::istringstream segments(path);
+    std::string segment;
+    while (std::getline(segments, segment, '/'))
+    {
+        if (!segment.empty())
         {
-            double score_;
-            if (type_left[i-1] == type_right[j-1])
-            {
-                switch (type_left[i-1])
-                {
-                    case 0:
-                    {
-                        score_ = Linus::jsondiff::JsonDiffer::drill_obj(left[i-1], right[j-1]);
-                        break;
-                    }
-                    case 1:
-                    {
-                        score_ = Linus::jsondiff::JsonDiffer::drill_LCS(left[i-1], right[j-1]);
-                        break;
-                    }
-                    case 2:
-                        score_ = (std::strcmp(left[i-1].GetString(), right[j-1].GetString()) == 0) ? 1 : 0;
-                        break;
-                    case 3:
-                        score_ = (left[i-1].GetInt() == right[j-1].GetInt());
-                        break;
-                    case 4:
-                        score_ = (left[i-1].GetDouble() == right[j-1].GetDouble());
-                        break;
-                    case 5:
-                        score_ = (left[i-1].GetBool() == right[j-1].GetBool());
-                        break;
-                    case 6:
-                        score_ = 1;
-                        break;
-                    default:
-                        score_ = 0;
-                        break;
-                }
-            }
-            else
-            {
-                score_ = 0;
-            }
-            if (score_ >= SIMILARITY_THRESHOLD)
-            {
-                dp[i][j] = dp[i - 1][j - 1] + score_;
-            }
-            else
-            {
-                dp[i][j] = std::max(dp[i - 1][j], dp[i][j - 1]);
-            }
+            match_key.push_back(segment);
         }
     }
-    return dp[len_left][len_right] / max(len_left, len_right);
 }
 
-double Linus::jsondiff::JsonDiffer::drill_obj(const rapidjson::Value& left, const rapidjson::Value& right)
+//digest of the scalar found at path, false when the element has no usable key
+bool Linus::jsondiff::JsonDiffer::element_key(const rapidjson::Value& element, const std::vector<std::string>& path, std::uint64_t& key)
 {
-    if (left.ObjectEmpty() && right.ObjectEmpty()) return 1.0;
-    if (left.ObjectEmpty() || right.ObjectEmpty()) return 0.0;
-    double score = 0;
-    unsigned int count = 0;
-    for (auto iter = left.MemberBegin(); iter != left.MemberEnd(); ++iter)
+    const rapidjson::Value* value = &element;
+    for (const auto& segment : path)
     {
-        const char* key = iter->name.GetString();
-        if (right.HasMember(key))
+        if (!value->IsObject())
         {
-            ++count;
-            double score_;
-            int type_left = Linus::jsondiff::JsonDiffer::get_type(iter->value);
-            int type_right = Linus::jsondiff::JsonDiffer::get_type(right[key]);
-            if (type_left == type_right)
-            {
-                switch (type_left)
-                {
-                    case 0:
-                    {
-                        score_ = Linus::jsondiff::JsonDiffer::drill_obj(iter->value, right[key]);
-                        break;
-                    }
-                    case 1:
-                    {
-                        score_ = Linus::jsondiff::JsonDiffer::drill_LCS(iter->value, right[key]);
-                        break;
-                    }
-                    case 2:
-                        score_ = (std::strcmp(iter->value.GetString(), right[key].GetString()) == 0) ? 1 : 0;
-                        break;
-                    case 3:
-                        score_ = (iter->value.GetInt() == right[key].GetInt());
-                        break;
-                    case 4:
-                        score_ = (iter->value.GetDouble() == right[key].GetDouble());
-                        break;
-                    case 5:
-                        score_ = (iter->value.GetBool() == right[key].GetBool());
-                        break;
-                    case 6:
-                        score_ = 1;
-                        break;
-                    default:
-                        score_ = 0;
-                        break;
-                }
-            }
-            else
+            return false;
+        }
+        auto member = value->FindMember(segment.c_str());
+        if (member == value->MemberEnd())
+        {
+            return false;
+        }
+        value = &member->value;
+    }
+    if (!(value->IsString() || value->IsNumber() || value->IsBool()))
+    {
+        return false;
+    }
+    key = get_hash(*value);
+    return true;
+}
+
+//a top level field of the first object that every object on both sides has, with a value unique on its side; "id" is tried first
+bool Linus::jsondiff::JsonDiffer::detect_key(Linus::jsondiff::TreeLevel& level, std::vector<std::string>& path)
+{
+    const rapidjson::Value* sample = nullptr;
+    for (unsigned int i = 0; i < level.left.Size() && sample == nullptr; ++i)
+    {
+        if (level.left[i].IsObject()) sample = &level.left[i];
+    }
+    if (sample == nullptr)
+    {
+        return false;
+    }
+    std::vector<std::string> candidates;
+    if (sample->HasMember("id"))
+    {
+        candidates.push_back("id");
+    }
+    Linus::jsondiff::Scratch<const rapidjson::Value::Member*> scratch(sample->MemberCount(), nullptr);
+    const rapidjson::Value::Member* const* members = key_index(*sample, scratch);
+    for (unsigned int i = 0; i < sample->MemberCount(); ++i)
+    {
+        const rapidjson::Value::Member* member = members[i];
+        std::string name(member->name.GetString(), member->name.GetStringLength());
+        if (name != "id") candidates.push_back(name);
+    }
+    for (const auto& candidate : candidates)
+    {
+        std::vector<std::string> candidate_path(1, candidate);
+        bool usable = true;
+        for (int side = 0; side < 2 && usable; ++side)
+        {
+            const rapidjson::Value& array = side == 0 ? level.left : level.right;
+            std::unordered_set<std::uint64_t> seen;
+            for (unsigned int i = 0; i < array.Size() && usable; ++i)
             {
-                score_ = 0;
+                if (!array[i].IsObject())
+                {
+                    continue;
+                }
+                std::uint64_t key;
+                usable = element_key(array[i], candidate_path, key) && seen.insert(key).second;
             }
-            score += score_;
+        }
+        if (usable)
+        {
+            path = candidate_path;
+            return true;
         }
     }
-    return score / (left.MemberCount() + right.MemberCount() - count);
+    return false;
 }
 
-std::vector<double> Linus::jsondiff::JsonDiffer::NWScore(bool reverse, Linus::jsondiff::TreeLevel level, bool drill, std::vector<int>& type_left, unsigned int sleft, unsigned int eleft, std::vector<int>& type_right, unsigned int sright, unsigned int eright)
+//hash join on the match key, elements without a unique key fall back to LCS among themselves
+//keyed elements without a partner stay unpaired and are reported as array:remove/array:add
+std::map<unsigned int, unsigned int> Linus::jsondiff::JsonDiffer::key_join(Linus::jsondiff::TreeLevel level, int& match)
 {
-    //if (reverse) std::cout << "Reverse ";
-    //std::cout << "NWScore sleft " << sleft << " eleft " << eleft << " sright " << sright << " eright " << eright << std::endl;
-    unsigned int len_left = eleft - sleft;
-    unsigned int len_right = eright - sright;
-    std::vector<std::vector<double>> dp(2, std::vector<double>(len_right + 2, 0));
-    dp[0][0] = 0;
-    for (int j = 1; j <= len_right; ++j)
+    std::vector<std::string> path = match_key;
+    if (auto_match_key && !detect_key(level, path))
     {
-        dp[0][j] = dp[0][j - 1];
+        return anchored_LCS(level, match);
     }
-    if (reverse)
+    unsigned int len_left = level.left.Size();
+    unsigned int len_right = level.right.Size();
+    const unsigned int KEYLESS = std::numeric_limits<unsigned int>::max();
+    std::vector<std::uint64_t> keys_left(len_left);
+    std::vector<bool> keyed_left(len_left, false);
+    std::unordered_map<std::uint64_t, unsigned int> index_left;
+    for (unsigned int i = 0; i < len_left; ++i)
     {
-        for (int i = 1; i <= len_left; ++i)
+        if (element_key(level.left[i], path, keys_left[i]))
         {
-            dp[1][0] = dp[0][0];
-            for (int j = 1; j <= len_right; ++j)
-            {
-                //std::cout << "left index " << eleft-i << " right " << eright-j << std::endl;
-                double score_;
-                if (type_left[eleft - i] == type_right[eright - j])
-                {
-                    switch (type_left[eleft - i])
-                    {
-                        case 0:
-                        {
-                            //Linus::jsondiff::TreeLevel level_(level.left[eleft - i], level.right[eright - j]);
-                            //score_ = Linus::jsondiff::JsonDiffer::compare_object(level_, true);
-                            score_ = Linus::jsondiff::JsonDiffer::drill_obj(level.left[eleft-i], level.right[eright-j]);
-                            break;
-                        }
-                        case 1:
-                        {
-                            //Linus::jsondiff::TreeLevel level_(level.left[eleft - i], level.right[eright - j]);
-                            //score_ = Linus::jsondiff::JsonDiffer::compare_array(level_, true);
-                            score_ = Linus::jsondiff::JsonDiffer::drill_LCS(level.left[eleft-i], level.right[eright-j]);
-                            break;
-                        }
-                        case 2:
-                            score_ = (std::strcmp(level.left[eleft-i].GetString(), level.right[eright-j].GetString()));
-                            break;
-                        case 3:
-                            score_ = (level.left[eleft-i].GetInt() == level.right[eright-j].GetInt());
-                            break;
-                        case 4:
-                            score_ = (level.left[eleft-i].GetDouble() == level.right[eright-j].GetDouble());
-                            break;
-                        case 5:
-                            score_ = (level.left[eleft-i].GetBool() == level.right[eright-j].GetBool());
-                            break;
-                        case 6:
-                            score_ = 1;
-                            break;
-                        default:
-                            score_ = 0;
-                            break;
-                    }
-                }
-                else
-                {
-                    score_ = 0;
-                }
-                dp[1][j] = std::max(dp[0][j - 1] + score_, std::max(dp[0][j], dp[1][j - 1]));
-            }
-            dp[0] = dp[1];
+            keyed_left[i] = true;
+            auto result = index_left.emplace(keys_left[i], i);
+            if (!result.second) result.first->second = KEYLESS;
         }
     }
-    else
+    std::vector<std::uint64_t> keys_right(len_right);
+    std::vector<bool> keyed_right(len_right, false);
+    std::unordered_map<std::uint64_t, unsigned int> index_right;
+    for (unsigned int j = 0; j < len_right; ++j)
     {
-        for (int i = 1; i <= len_left; ++i)
+        if (element_key(level.right[j], path, keys_right[j]))
         {
-            dp[1][0] = dp[0][0];
-            for (int j = 1; j <= len_right; ++j)
+            keyed_right[j] = true;
+            auto result = index_right.emplace(keys_right[j], j);
+            if (!result.second) result.first->second = KEYLESS;
+        }
+    }
+    std::map<unsigned int, unsigned int> pair_list;
+    std::vector<unsigned int> rest_left, rest_right;
+    for (unsigned int i = 0; i < len_left; ++i)
+    {
+        if (!keyed_left[i] || index_left[keys_left[i]] == KEYLESS)
+        {
+            rest_left.push_back(i);
+            continue;
+        }
+        //a key that is unique here but repeated on the other side cannot be joined either
+        auto partner = index_right.find(keys_left[i]);
+        if (partner != index_right.end() && partner->second == KEYLESS)
+        {
+            rest_left.push_back(i);
+        }
+        else if (partner != index_right.end())
+        {
+            pair_list[i] = partner->second;
+        }
+    }
+    for (unsigned int j = 0; j < len_right; ++j)
+    {
+        auto partner = keyed_right[j] ? index_left.find(keys_right[j]) : index_left.end();
+        if (!keyed_right[j] || index_right[keys_right[j]] == KEYLESS || (partner != index_left.end() && partner->second == KEYLESS))
+        {
+            rest_right.push_back(j);
+        }
+    }
+    match = rest_left.empty() || rest_right.empty() ? FULL_MATCH : gap_match(level, static_cast<std::uint64_t>(rest_left.size()) * rest_right.size());
+    if (match != FULL_MATCH)
+    {
+        std::map<unsigned int, unsigned int> rest_pairs;
+        if (match == HASH_MATCH)
+        {
+            std::vector<std::uint64_t> hash_left(rest_left.size());
+            std::vector<std::uint64_t> hash_right(rest_right.size());
+            for (unsigned int i = 0; i < rest_left.size(); ++i)
             {
-                double score_;
-                if (type_left[sleft + i - 1] == type_right[sright + j - 1])
-                {
-                    switch (type_left[sleft + i - 1])
-                    {
-                        case 0:
-                        {
-                            //Linus::jsondiff::TreeLevel level_(level.left[sleft + i - 1], level.right[sright + j - 1]);
-                            //Linus::jsondiff::TreeLevel level_(level.left[1], level.right[23]);
-                            //score_ = Linus::jsondiff::JsonDiffer::compare_object(level_, true);
-                            score_ = Linus::jsondiff::JsonDiffer::drill_obj(level.left[sleft+i-1], level.right[sright+j-1]);
-                            break;
-                        }
-                        case 1:
-                        {
-                            //Linus::jsondiff::TreeLevel level_(level.left[sleft + i - 1], level.right[sright + j - 1]);
-                            //score_ = Linus::jsondiff::JsonDiffer::compare_array(level_, true);
-                            score_ = Linus::jsondiff::JsonDiffer::drill_LCS(level.left[sleft+i-1], level.right[sright+j-1]);
-                            break;
-                        }
-                        case 2:
-                            score_ = (std::strcmp(level.left[sleft+i-1].GetString(), level.right[sright+j-1].GetString()) == 0);
-                            break;
-                        case 3:
-                            score_ = (level.left[sleft+i-1].GetInt() == level.right[sright+j-1].GetInt());
-                            break;
-                        case 4:
-                            score_ = (level.left[sleft+i-1].GetDouble() == level.right[sright+j-1].GetDouble());
-                            break;
-                        case 5:
-                            score_ = (level.left[sleft+i-1].GetBool() == level.right[sright+j-1].GetBool());
-                            break;
-                        case 6:
-                            score_ = 1;
-                            break;
-                        default:
-                            score_ = 0;
-                            break;
-                    }
-                }
-                else
-                {
-                    score_ = 0;
-                }
-                dp[1][j] = std::max(dp[0][j - 1] + score_, std::max(dp[0][j], dp[1][j - 1]));
+                hash_left[i] = element_hash(level.left[rest_left[i]], get_type(level.left[rest_left[i]]));
+            }
+            for (unsigned int j = 0; j < rest_right.size(); ++j)
+            {
+                hash_right[j] = element_hash(level.right[rest_right[j]], get_type(level.right[rest_right[j]]));
+            }
+            if (hirscheburg || !Myers(hash_left, 0, rest_left.size(), hash_right, 0, rest_right.size(), rest_pairs))
+            {
+                Myers_linear(hash_left, 0, rest_left.size(), hash_right, 0, rest_right.size(), rest_pairs);
             }
-            dp[0] = dp[1];
         }
+        pair_gaps(rest_pairs, 0, rest_left.size(), 0, rest_right.size());
+        for (const auto& pair : rest_pairs)
+        {
+            pair_list[rest_left[pair.first]] = rest_right[pair.second];
+        }
+        return pair_list;
+    }
+    for (const auto& pair : index_LCS(level, rest_left, rest_right))
+    {
+        pair_list[pair.first] = pair.second;
     }
-    return dp[1];
+    return pair_list;
 }
 
-std::map<unsigned int, unsigned int> Linus::jsondiff::JsonDiffer::Hirschberg(Linus::jsondiff::TreeLevel level, bool drill, std::vector<int>& type_left, unsigned int sleft, unsigned int eleft, std::vector<int>& type_right, unsigned int sright, unsigned int eright)
+//LCS over two index lists, same scoring and traceback as LCS
+std::map<unsigned int, unsigned int> Linus::jsondiff::JsonDiffer::index_LCS(Linus::jsondiff::TreeLevel& level, std::vector<unsigned int>& left_index, std::vector<unsigned int>& right_index)
 {
-    //std::cout << "Hirschberg sleft " << sleft << " eleft " << eleft << " sright " << sright << " eright " << eright << std::endl;
-    unsigned int len_left = eleft - sleft + 1;
-    //std::cout << "len_left " << len_left << std::endl;
-    unsigned int len_right = eright - sright + 1;
     std::map<unsigned int, unsigned int> pair_list;
-    /*directly report here*/
+    unsigned int len_left = left_index.size();
+    unsigned int len_right = right_index.size();
     if (len_left == 0 || len_right == 0)
     {
         return pair_list;
     }
-    if (len_left == 1 || len_right == 1)/////////////////////////////////////////////////////////
+    Linus::jsondiff::Scratch<int> type_right(len_right, 0);
+    Linus::jsondiff::Scratch<std::uint64_t> hash_right(len_right, 0);
+    for (unsigned int j = 0; j < len_right; ++j)
     {
-        double score_;
-        if (type_left[sleft] == type_right[sright])
+        type_right[j] = get_type(level.right[right_index[j]]);
+        hash_right[j] = get_hash(level.right[right_index[j]]);
+    }
+    Linus::jsondiff::Scratch<double> previous(len_right + 1, 0.0);
+    Linus::jsondiff::Scratch<double> current(len_right + 1, 0.0);
+    Linus::jsondiff::DirectionPlane moves(len_left, len_right);
+    Linus::jsondiff::Stats::count(Linus::jsondiff::Stats::DP_CELLS, static_cast<std::uint64_t>(len_left) * len_right);
+    for (unsigned int i = 1; i <= len_left; ++i)
+    {
+        const rapidjson::Value& left_value = level.left[left_index[i - 1]];
+        int type_left = get_type(left_value);
+        std::uint64_t hash_left = get_hash(left_value);
+        for (unsigned int j = 1; j <= len_right; ++j)
         {
-            switch (type_left[sleft])
+            double score_ = pair_score(left_value, level.right[right_index[j - 1]], type_left, type_right[j - 1], hash_left, hash_right[j - 1]);
+            if (score_ >= SIMILARITY_THRESHOLD)
             {
-                case 0:
-                {
-                    //Linus::jsondiff::TreeLevel level_(level.left[sleft], level.right[sright]);
-                    //score_ = Linus::jsondiff::JsonDiffer::compare_object(level_, true);
-                    score_ = Linus::jsondiff::JsonDiffer::drill_obj(level.left[sleft], level.right[sright]);
-                    break;
-                }
-                case 1:
-                {
-                    //Linus::jsondiff::TreeLevel level_(level.left[sleft], level.right[sright]);
-                    //score_ = Linus::jsondiff::JsonDiffer::compare_array(level_, true);
-                    score_ = Linus::jsondiff::JsonDiffer::drill_LCS(level.left[sleft], level.right[sright]);
-                    break;
-                }
-                case 2:
-                    score_ = (std::strcmp(level.left[sleft].GetString(), level.right[sright].GetString()) == 0);
-                    break;
-                case 3:
-                    score_ = (level.left[sleft].GetInt() == level.right[sright].GetInt());
-                    break;
-                case 4:
-                    score_ = (level.left[sleft].GetDouble() == level.right[sright].GetDouble());
-                    break;
-                case 5:
-                    score_ = (level.left[sleft].GetBool() == level.right[sright].GetBool());
-                    break;
-                case 6:
-                    score_ = 1;
-                    break;
-                default:
-                    score_ = 0;
-                    break;
+                current[j] = previous[j - 1] + score_;
+                moves.set(i - 1, j - 1, Linus::jsondiff::DirectionPlane::DIAGONAL);
+            }
+            else
+            {
+                current[j] = std::max(previous[j], current[j - 1]);
+                moves.set(i - 1, j - 1, previous[j] > current[j - 1] ? Linus::jsondiff::DirectionPlane::UP : Linus::jsondiff::DirectionPlane::LEFT);
             }
         }
-        else
+        previous.swap(current);
+    }
+    unsigned int i = len_left;
+    unsigned int j = len_right;
+    while (i > 0 && j > 0)
+    {
+        unsigned char move = moves.get(i - 1, j - 1);
+        if (move == Linus::jsondiff::DirectionPlane::DIAGONAL)
         {
-            score_ = 0;
+            pair_list[left_index[i - 1]] = right_index[j - 1];
+            --i;
+            --j;
         }
-        if (score_ >= SIMILARITY_THRESHOLD)
+        else if (move == Linus::jsondiff::DirectionPlane::UP)
         {
-            pair_list[sleft] = sright;
+            --i;
+        }
+        else
+        {
+            --j;
         }
     }
-    else
+    return pair_list;
+}
+
+//greedy forward Myers over left[sleft, eleft) and right[sright, eright) comparing elements by digest,
+//the V vector of every round is kept for the traceback, gives up (returns false) when that would exceed MAX_TRACE
+bool Linus::jsondiff::JsonDiffer::Myers(std::vector<std::uint64_t>& hash_left, unsigned int sleft, unsigned int eleft, std::vector<std::uint64_t>& hash_right, unsigned int sright, unsigned int eright, std::map<unsigned int, unsigned int>& pair_list)
+{
+    const std::size_t MAX_TRACE = 1 << 24;
+    int len_left = eleft - sleft;
+    int len_right = eright - sright;
+    int max_d = len_left + len_right;
+    std::vector<int> v(2 * max_d + 3, 0);
+    std::vector<std::vector<int>> trace;
+    std::size_t trace_size = 0;
+    int offset = max_d + 1;
+    int d_end = -1;
+    for (int d = 0; d <= max_d && d_end < 0; ++d)
     {
-        unsigned int left_mid = (sleft + eleft) / 2;
-        //std::cout << "left_mid " << left_mid << std::endl;
-        std::vector<double> scoreL = NWScore(false, level, true, type_left, sleft, left_mid, type_right, sright, eright);
-        std::vector<double> scoreR = NWScore(true, level, true, type_left, left_mid + 1, eleft, type_right, sright, eright);
-        std::reverse(scoreR.begin(), scoreR.end());
-        unsigned int right_mid;
-        double max = -1;
-        for (unsigned int i = 0; i < scoreL.size(); ++i)
+        trace_size += 2 * d + 1;
+        if (trace_size > MAX_TRACE)
+        {
+            return false;
+        }
+        for (int k = -d; k <= d; k += 2)
         {
-            double score_ = std::ceil(scoreL[i] + scoreR[i]);
-            if (score_ > max)
+            int x;
+            if (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1]))
+            {
+                x = v[offset + k + 1];
+            }
+            else
+            {
+                x = v[offset + k - 1] + 1;
+            }
+            int y = x - k;
+            while (x < len_left && y < len_right && hash_left[sleft + x] == hash_right[sright + y])
             {
-                max = score_;
-                right_mid = sright + i;
+                ++x;
+                ++y;
+            }
+            v[offset + k] = x;
+            if (x >= len_left && y >= len_right)
+            {
+                d_end = d;
+                break;
             }
         }
-        //std::cout << "right_mid " << right_mid << std::endl;
-        for (const auto& pair : Hirschberg(level, drill, type_left, sleft, left_mid, type_right, sright, right_mid)) 
+        trace.push_back(std::vector<int>(v.begin() + offset - d, v.begin() + offset + d + 1));
+    }
+
+    int x = len_left;
+    int y = len_right;
+    for (int d = d_end; d >= 0; --d)
+    {
+        int k = x - y;
+        int x_start = 0;
+        int y_start = 0;
+        if (d > 0)
         {
-            pair_list.insert(pair);
+            std::vector<int>& previous = trace[d - 1];
+            int previous_k;
+            if (k == -d || (k != d && previous[k - 1 + d - 1] < previous[k + 1 + d - 1]))
+            {
+                previous_k = k + 1;
+            }
+            else
+            {
+                previous_k = k - 1;
+            }
+            int previous_x = previous[previous_k + d - 1];
+            int previous_y = previous_x - previous_k;
+            x_start = (previous_k == k + 1) ? previous_x : previous_x + 1;
+            y_start = x_start - k;
+            while (x > x_start && y > y_start)
+            {
+                --x;
+                --y;
+                pair_list[sleft + x] = sright + y;
+            }
+            x = previous_x;
+            y = previous_y;
         }
-        for (const auto& pair : Hirschberg(level, drill, type_left, left_mid + 1, eleft, type_right, right_mid + 1, eright)) 
+        else
         {
-            pair_list.insert(pair);
+            while (x > 0 && y > 0)
+            {
+                --x;
+                --y;
+                pair_list[sleft + x] = sright + y;
+            }
         }
     }
-    return pair_list;
+    return true;
 }
 
-std::map<unsigned int, unsigned int> Linus::jsondiff::JsonDiffer::Hirschberg_starter(Linus::jsondiff::TreeLevel level)
+//linear space Myers, the middle snake is found by running the forward and reverse searches towards each other
+//and the two halves are solved recursively (the bisection of diff-match-patch)
+void Linus::jsondiff::JsonDiffer::Myers_linear(std::vector<std::uint64_t>& hash_left, unsigned int sleft, unsigned int eleft, std::vector<std::uint64_t>& hash_right, unsigned int sright, unsigned int eright, std::map<unsigned int, unsigned int>& pair_list)
 {
-    unsigned int len_left = level.left.Size();
-    unsigned int len_right = level.right.Size();
-    std::vector<int> type_left(len_left);
-    std::vector<int> type_right(len_right);
-    for (unsigned int i = 0; i < len_left; ++i)
+    while (sleft < eleft && sright < eright && hash_left[sleft] == hash_right[sright])
     {
-        type_left[i] =  Linus::jsondiff::JsonDiffer::get_type(level.left[i]);
+        pair_list[sleft] = sright;
+        ++sleft;
+        ++sright;
     }
-    for (unsigned int j = 0; j < len_right; ++j)
+    while (sleft < eleft && sright < eright && hash_left[eleft - 1] == hash_right[eright - 1])
     {
-        type_right[j] = Linus::jsondiff::JsonDiffer::get_type(level.right[j]);
+        pair_list[eleft - 1] = eright - 1;
+        --eleft;
+        --eright;
+    }
+    int len_left = eleft - sleft;
+    int len_right = eright - sright;
+    if (len_left == 0 || len_right == 0)
+    {
+        return;
+    }
+    int max_d = (len_left + len_right + 1) / 2;
+    int offset = max_d;
+    std::vector<int> forward(2 * max_d + 2, -1);
+    std::vector<int> reverse(2 * max_d + 2, -1);
+    forward[offset + 1] = 0;
+    reverse[offset + 1] = 0;
+    int delta = len_left - len_right;
+    bool front = (delta % 2 != 0);
+    int k1_start = 0, k1_end = 0, k2_start = 0, k2_end = 0;
+    for (int d = 0; d < max_d; ++d)
+    {
+        for (int k1 = -d + k1_start; k1 <= d - k1_end; k1 += 2)
+        {
+            int k1_offset = offset + k1;
+            int x1;
+            if (k1 == -d || (k1 != d && forward[k1_offset - 1] < forward[k1_offset + 1]))
+            {
+                x1 = forward[k1_offset + 1];
+            }
+            else
+            {
+                x1 = forward[k1_offset - 1] + 1;
+            }
+            int y1 = x1 - k1;
+            while (x1 < len_left && y1 < len_right && hash_left[sleft + x1] == hash_right[sright + y1])
+            {
+                ++x1;
+                ++y1;
+            }
+            forward[k1_offset] = x1;
+            if (x1 > len_left)
+            {
+                k1_end += 2;
+            }
+            else if (y1 > len_right)
+            {
+                k1_start += 2;
+            }
+            else if (front)
+            {
+                int k2_offset = offset + delta - k1;
+                if (k2_offset >= 0 && k2_offset < (int)reverse.size() && reverse[k2_offset] != -1 && x1 >= len_left - reverse[k2_offset])
+                {
+                    Myers_linear(hash_left, sleft, sleft + x1, hash_right, sright, sright + y1, pair_list);
+                    Myers_linear(hash_left, sleft + x1, eleft, hash_right, sright + y1, eright, pair_list);
+                    return;
+                }
+            }
+        }
+        for (int k2 = -d + k2_start; k2 <= d - k2_end; k2 += 2)
+        {
+            int k2_offset = offset + k2;
+            int x2;
+            if (k2 == -d || (k2 != d && reverse[k2_offset - 1] < reverse[k2_offset + 1]))
+            {
+                x2 = reverse[k2_offset + 1];
+            }
+            else
+            {
+                x2 = reverse[k2_offset - 1] + 1;
+            }
+            int y2 = x2 - k2;
+            while (x2 < len_left && y2 < len_right && hash_left[eleft - x2 - 1] == hash_right[eright - y2 - 1])
+            {
+                ++x2;
+                ++y2;
+            }
+            reverse[k2_offset] = x2;
+            if (x2 > len_left)
+            {
+                k2_end += 2;
+            }
+            else if (y2 > len_right)
+            {
+                k2_start += 2;
+            }
+            else if (!front)
+            {
+                int k1_offset = offset + delta - k2;
+                if (k1_offset >= 0 && k1_offset < (int)forward.size() && forward[k1_offset] != -1)
+                {
+                    int x1 = forward[k1_offset];
+                    int y1 = offset + x1 - k1_offset;
+                    if (x1 >= len_left - x2)
+                    {
+                        Myers_linear(hash_left, sleft, sleft + x1, hash_right, sright, sright + y1, pair_list);
+                        Myers_linear(hash_left, sleft + x1, eleft, hash_right, sright + y1, eright, pair_list);
+                        return;
+                    }
+                }
+            }
+        }
     }
-    return Hirschberg(level, true, type_left, 0, len_left-1, type_right, 0, len_right-1);
+    //nothing in common
 }
 
 double Linus::jsondiff::JsonDiffer::compare_array_advanced(Linus::jsondiff::TreeLevel level, bool drill)
 {
     std::map<unsigned int, unsigned int> pairlist;
+    int match = FULL_MATCH;
     //auto start = std::chrono::high_resolution_clock::now();
-    if (num_thread == 1)
+    if (auto_match_key || !match_key.empty())
     {
-        if(!hirscheburg) pairlist = LCS(level, drill);
-        else pairlist = Hirschberg_starter(level);
-        //pairlist = Hirschberg_starter(level);
-        /*Linus::jsondiff::BottomUpLCS BU(level, *this);
-        BU.bu_computing();
-        pairlist = BU.LCS();*/
+        pairlist = key_join(level, match);
     }
     else
     {
-        pairlist = parallel_LCS(level);
+        pairlist = anchored_LCS(level, match);
+    }
+    //an array whose DP did not fit the budget is flagged once, the elements it paired are still diffed as usual
+    if (match != FULL_MATCH)
+    {
+        Linus::jsondiff::Stats::count(Linus::jsondiff::Stats::ARRAYS_DOWNGRADED, 1);
+        if (!drill)
+        {
+            Linus::jsondiff::JsonDiffer::report_paths(match == HASH_MATCH ? EVENT_ARRAY_HASH_MATCH : EVENT_ARRAY_INDEX_MATCH, level);
+        }
     }
+    //pairlist = Hirschberg_starter(level);
+    /*Linus::jsondiff::BottomUpLCS BU(level, *this);
+    BU.bu_computing();
+    pairlist = BU.LCS();*/
     //auto finish = std::chrono::high_resolution_clock::now();
     //std::chrono::duration<double> elapsed = finish - start;
     //std::cout << "TopDown LCS: " << elapsed.count() << " s\n";
     //std::cout << "BottomUp time: " << elapsed.count() << " s\n";
-    std::vector<unsigned int> paired_left;
-    std::vector<unsigned int> paired_right;
+    unsigned int len_left = level.left.Size();
+    unsigned int len_right = level.right.Size();
+    std::vector<bool> paired_left(len_left, false);
+    std::vector<bool> paired_right(len_right, false);
     for (const auto& pair : pairlist)
     {
-        paired_left.push_back(pair.first);
-        paired_right.push_back(pair.second);
+        paired_left[pair.first] = true;
+        paired_right[pair.second] = true;
         //std::cout << "Pair Left " << pair.first << " Right " << pair.second << std::endl;
     }
-    unsigned int len_left = level.left.Size();
-    unsigned int len_right = level.right.Size();
     double total_score = 0;
-    double score_;
-    for (const auto& pair : pairlist)
+    std::vector<std::pair<unsigned int, unsigned int>> pairs(pairlist.begin(), pairlist.end());
+    Linus::jsondiff::Scratch<double> scores(pairs.size(), 0.0);
+    tbb::task_group group;
+    for (unsigned int k = 0; k < pairs.size(); ++k)
     {
-        if (!drill)
-        {
-            std::ostringstream _left_path;
-            _left_path << level.left_path << "[" << std::to_string(pair.first) << "]";
-            std::string left_path = _left_path.str();
-            std::ostringstream _right_path;
-            _right_path << level.right_path << "[" << std::to_string(pair.second) << "]";
-            std::string right_path = _right_path.str();
-            Linus::jsondiff::TreeLevel level_(level.left[pair.first], level.right[pair.second], left_path, right_path, level.left_path);
-            score_ = diff_level(level_, drill);
-            total_score += score_;
-            //std::cout << "Pair Left " << pair.first << " Right " << pair.second << std::endl;
-        }
-        else
+        auto task = [this, &level, &pairs, &scores, k, drill]()
         {
-            Linus::jsondiff::TreeLevel level_(level.left[pair.first], level.right[pair.second]);
-            score_ = _diff_level(level_, drill);
-        }
+            const std::pair<unsigned int, unsigned int>& pair = pairs[k];
+            if (!drill)
+            {
+                Linus::jsondiff::PathNode left_path(level.left_path, pair.first);
+                Linus::jsondiff::PathNode right_path(level.right_path, pair.second);
+                Linus::jsondiff::TreeLevel level_(level.left[pair.first], level.right[pair.second], &left_path, &right_path, level.left_path);
+                scores[k] = diff_level(level_, drill);
+                //std::cout << "Pair Left " << pair.first << " Right " << pair.second << std::endl;
+            }
+            else
+            {
+                Linus::jsondiff::TreeLevel level_(level.left[pair.first], level.right[pair.second]);
+                _diff_level(level_, drill);
+            }
+        };
+        if (spawn_task(level.left[pairs[k].first], level.right[pairs[k].second])) fork_task(group, task);
+        else task();
     }
-    rapidjson::Value emptyValue("");
-    const rapidjson::Value& emptyRef = emptyValue;
+    join_tasks(group);
+    for (unsigned int k = 0; k < pairs.size(); ++k)
+    {
+        total_score += scores[k];
+    }
+    const rapidjson::Value& emptyRef = empty_value;
     for (unsigned int index = 0; index < len_left; ++index)
     {
-        if (std::find(paired_left.begin(), paired_left.end(), index) != paired_left.end())
+        if (paired_left[index])
         {
             continue;
         }
         if (!drill) 
         {
-            std::ostringstream _left_path;
-            _left_path << level.left_path << "[" << std::to_string(index) << "]";
-            std::string left_path = _left_path.str();
-            Linus::jsondiff::TreeLevel level_(level.left[index], emptyRef, left_path, level.empty_string, level.left_path);
+            Linus::jsondiff::PathNode left_path(level.left_path, index);
+            Linus::jsondiff::TreeLevel level_(level.left[index], emptyRef, &left_path, nullptr, level.left_path);
             Linus::jsondiff::JsonDiffer::report(EVENT_ARRAY_REMOVE, level_);
         }
     }
     for (unsigned int index = 0; index < len_right; ++index)
     {
-        if (std::find(paired_right.begin(), paired_right.end(), index) != paired_right.end())
+        if (paired_right[index])
         {
             continue;
         }
         if (!drill) 
         {
-            std::ostringstream _right_path;
-            _right_path << level.right_path << "[" << std::to_string(index) << "]";
-            std::string right_path = _right_path.str();
-            Linus::jsondiff::TreeLevel level_(emptyRef, level.right[index], level.empty_string, right_path, level.right_path);
+            Linus::jsondiff::PathNode right_path(level.right_path, index);
+            Linus::jsondiff::TreeLevel level_(emptyRef, level.right[index], nullptr, &right_path, level.right_path);
             Linus::jsondiff::JsonDiffer::report(EVENT_ARRAY_ADD, level_);
         }
     }
@@ -981,72 +3118,83 @@ double Linus::jsondiff::JsonDiffer::compare_array_advanced(Linus::jsondiff::Tree
 double Linus::jsondiff::JsonDiffer::compare_object(Linus::jsondiff::TreeLevel level, bool drill)
 {
     double score = 0;
-    std::vector<std::string> left_keys = KeysFromObject(level.left);
-    std::vector<std::string> right_keys = KeysFromObject(level.right);
-    std::vector<std::string> all_keys;
-    all_keys.insert(all_keys.end(), left_keys.begin(), left_keys.end());
-    all_keys.insert(all_keys.end(), right_keys.begin(), right_keys.end());
-    std::sort(all_keys.begin(), all_keys.end());
-    auto last = std::unique(all_keys.begin(), all_keys.end());
-    all_keys.erase(last, all_keys.end());
+    unsigned int len_left = level.left.MemberCount();
+    unsigned int len_right = level.right.MemberCount();
+    Linus::jsondiff::Scratch<const rapidjson::Value::Member*> left_scratch(len_left, nullptr);
+    Linus::jsondiff::Scratch<const rapidjson::Value::Member*> right_scratch(len_right, nullptr);
+    const rapidjson::Value::Member* const* left_keys = key_index(level.left, left_scratch);
+    const rapidjson::Value::Member* const* right_keys = key_index(level.right, right_scratch);
+    //sorted union of the keys, a duplicated key resolves to its first member like operator[]
+    Linus::jsondiff::Scratch<std::pair<const rapidjson::Value::Member*, const rapidjson::Value::Member*>> all_keys(len_left + len_right, std::make_pair(nullptr, nullptr));
+    unsigned int key_count = 0;
+    unsigned int i = 0;
+    unsigned int j = 0;
+    while (i < len_left || j < len_right)
+    {
+        int order = i == len_left ? 1 : (j == len_right ? -1 : compare_name(left_keys[i], right_keys[j]));
+        const rapidjson::Value::Member* left_member = order <= 0 ? left_keys[i] : nullptr;
+        const rapidjson::Value::Member* right_member = order >= 0 ? right_keys[j] : nullptr;
+        all_keys[key_count++] = std::make_pair(left_member, right_member);
+        while (left_member != nullptr && i < len_left && compare_name(left_keys[i], left_member) == 0) ++i;
+        while (right_member != nullptr && j < len_right && compare_name(right_keys[j], right_member) == 0) ++j;
+    }
 
-    double score_;
-    for (const auto& item : all_keys)
+    Linus::jsondiff::Scratch<double> scores(key_count, 0.0);
+    tbb::task_group group;
+    const rapidjson::Value& emptyRef = empty_value;
+    for (unsigned int k = 0; k < key_count; ++k)
     {
-        if ((std::find(left_keys.begin(), left_keys.end(), item) != left_keys.end()) && (std::find(right_keys.begin(), right_keys.end(), item) != right_keys.end()))
+        const rapidjson::Value::Member* left_member = all_keys[k].first;
+        const rapidjson::Value::Member* right_member = all_keys[k].second;
+        if (left_member != nullptr && right_member != nullptr)
         {
-            if (!drill)
-            {
-                std::ostringstream _left_path;
-                _left_path << level.left_path << "[\"" << item << "\"]";
-                std::string left_path = _left_path.str();
-                std::ostringstream _right_path;
-                _right_path << level.right_path << "[\"" << item << "\"]";
-                std::string right_path = _right_path.str();
-                Linus::jsondiff::TreeLevel level_(level.left[item.c_str()], level.right[item.c_str()], left_path, right_path, level.left_path);
-                score_ = diff_level(level_, drill);
-            }
-            else
+            auto task = [this, &level, &scores, left_member, right_member, k, drill]()
             {
-                Linus::jsondiff::TreeLevel level_(level.left[item.c_str()], level.right[item.c_str()]);
-                score_ = _diff_level(level_, drill);
-            }
-            score += score_;
+                if (!drill)
+                {
+                    Linus::jsondiff::PathNode left_path(level.left_path, left_member->name);
+                    Linus::jsondiff::PathNode right_path(level.right_path, right_member->name);
+                    Linus::jsondiff::TreeLevel level_(left_member->value, right_member->value, &left_path, &right_path, level.left_path);
+                    scores[k] = diff_level(level_, drill);
+                }
+                else
+                {
+                    Linus::jsondiff::TreeLevel level_(left_member->value, right_member->value);
+                    scores[k] = _diff_level(level_, drill);
+                }
+            };
+            if (spawn_task(left_member->value, right_member->value)) fork_task(group, task);
+            else task();
             continue;
         }
 
-        rapidjson::Value emptyValue("");
-        const rapidjson::Value& emptyRef = emptyValue;
-        if (std::find(left_keys.begin(), left_keys.end(), item) != left_keys.end())
+        if (left_member != nullptr)
         {
             if (!drill) 
             {
-                std::ostringstream _left_path;
-                _left_path << level.left_path << "[\"" << item << "\"]";
-                std::string left_path = _left_path.str();
-                Linus::jsondiff::TreeLevel level_(level.left[item.c_str()], emptyRef, left_path, level.empty_string, level.left_path);
+                Linus::jsondiff::PathNode left_path(level.left_path, left_member->name);
+                Linus::jsondiff::TreeLevel level_(left_member->value, emptyRef, &left_path, nullptr, level.left_path);
                 Linus::jsondiff::JsonDiffer::report(EVENT_OBJECT_REMOVE, level_);
             }
             continue;
         }
-        if (std::find(right_keys.begin(), right_keys.end(), item) != right_keys.end())
+        if (!drill) 
         {
-            if (!drill) 
-            {
-                std::ostringstream _right_path;
-                _right_path << level.right_path << "[\"" << item << "\"]";
-                std::string right_path = _right_path.str();
-                Linus::jsondiff::TreeLevel level_(emptyRef, level.right[item.c_str()], level.empty_string, right_path, level.right_path);
-                Linus::jsondiff::JsonDiffer::report(EVENT_OBJECT_ADD, level_);
-            }
-            continue;
+            Linus::jsondiff::PathNode right_path(level.right_path, right_member->name);
+            Linus::jsondiff::TreeLevel level_(emptyRef, right_member->value, nullptr, &right_path, level.right_path);
+            Linus::jsondiff::JsonDiffer::report(EVENT_OBJECT_ADD, level_);
         }
     }
-    if (all_keys.empty())
+    join_tasks(group);
+    for (unsigned int k = 0; k < key_count; ++k)
+    {
+        score += scores[k];
+    }
+    if (key_count == 0)
     {
         return 1;
     }
-    return score / all_keys.size();
+    return score / key_count;
 }
 
 double Linus::jsondiff::JsonDiffer::compare_Int(Linus::jsondiff::TreeLevel level, bool drill)
@@ -1103,6 +3251,11 @@ double Linus::jsondiff::JsonDiffer::compare_Bool(Linus::jsondiff::TreeLevel leve
 
 double Linus::jsondiff::JsonDiffer::_diff_level(Linus::jsondiff::TreeLevel level, bool drill)
 {
+    Linus::jsondiff::Stats::count(Linus::jsondiff::Stats::NODES_VISITED, 1);
+    if (same_subtree(level.left, level.right))
+    {
+        return 1;
+    }
     int type = level.get_type();
     switch (type)
     {
@@ -1128,6 +3281,11 @@ double Linus::jsondiff::JsonDiffer::_diff_level(Linus::jsondiff::TreeLevel level
         return 1;
         break;
     case 7:
+        //Int64 and Uint64 values land here, equal ones are not a change
+        if (level.left == level.right)
+        {
+            return 1;
+        }
         if (!drill)
         {
             Linus::jsondiff::JsonDiffer::report(EVENT_VALUE_CHANGE, level);
@@ -1142,23 +3300,485 @@ double Linus::jsondiff::JsonDiffer::_diff_level(Linus::jsondiff::TreeLevel level
 
 double Linus::jsondiff::JsonDiffer::diff_level(Linus::jsondiff::TreeLevel level, bool drill)
 {
-    /*std::ostringstream oss;
-    oss << "[" << level.get_key() << "]@[" << std::boolalpha << drill << "]";
-    std::string cache_key = oss.str();
-    if (cache.find(cache_key) == cache.end())
-    {
-        double score = _diff_level(level, drill);
-        cache[cache_key] = score;
-    }
-    double score = cache[cache_key];
-    return score;*/
     return _diff_level(level, drill);
 }
 
 bool Linus::jsondiff::JsonDiffer::diff()
 {
+    Linus::jsondiff::StatTimer timer(Linus::jsondiff::Stats::DIFF);
     Linus::jsondiff::TreeLevel root_level(left, right);
-    return Linus::jsondiff::JsonDiffer::diff_level(root_level, false) == 1.0;
+    double score;
+    buffer.clear();
+    arena.execute([&]
+    {
+        Linus::jsondiff::DiffBuffer* saved = current_buffer;
+        current_buffer = &buffer;
+        score = Linus::jsondiff::JsonDiffer::diff_level(root_level, false);
+        current_buffer = saved;
+    });
+    if (sink != nullptr)
+    {
+        buffer.flush(*sink);
+        sink->flush();
+    }
+    else
+    {
+        buffer.merge(records);
+    }
+    return score == 1.0;
+}
+
+Linus::jsondiff::SaxToken::SaxToken() : kind(NONE), scalar(0), boolean(false), integer(0), unsigned_integer(0), number(0)
+{
+
+}
+
+//scalar: 0 null, 1 bool, 2 int, 3 uint, 4 int64, 5 uint64, 6 double, 7 string
+bool Linus::jsondiff::SaxToken::Null()
+{
+    kind = SCALAR;
+    scalar = 0;
+    return true;
+}
+
+bool Linus::jsondiff::SaxToken::Bool(bool b)
+{
+    kind = SCALAR;
+    scalar = 1;
+    boolean = b;
+    return true;
+}
+
+bool Linus::jsondiff::SaxToken::Int(int i)
+{
+    kind = SCALAR;
+    scalar = 2;
+    integer = i;
+    return true;
+}
+
+bool Linus::jsondiff::SaxToken::Uint(unsigned u)
+{
+    kind = SCALAR;
+    scalar = 3;
+    unsigned_integer = u;
+    return true;
+}
+
+bool Linus::jsondiff::SaxToken::Int64(std::int64_t i)
+{
+    kind = SCALAR;
+    scalar = 4;
+    integer = i;
+    return true;
+}
+
+bool Linus::jsondiff::SaxToken::Uint64(std::uint64_t u)
+{
+    kind = SCALAR;
+    scalar = 5;
+    unsigned_integer = u;
+    return true;
+}
+
+bool Linus::jsondiff::SaxToken::Double(double d)
+{
+    kind = SCALAR;
+    scalar = 6;
+    number = d;
+    return true;
+}
+
+bool Linus::jsondiff::SaxToken::RawNumber(const char* str, rapidjson::SizeType length, bool copy)
+{
+    return String(str, length, copy);
+}
+
+bool Linus::jsondiff::SaxToken::String(const char* str, rapidjson::SizeType length, bool)
+{
+    kind = SCALAR;
+    scalar = 7;
+    text.assign(str, length);
+    return true;
+}
+
+bool Linus::jsondiff::SaxToken::StartObject()
+{
+    kind = START_OBJECT;
+    return true;
+}
+
+bool Linus::jsondiff::SaxToken::Key(const char* str, rapidjson::SizeType length, bool)
+{
+    kind = KEY;
+    text.assign(str, length);
+    return true;
+}
+
+bool Linus::jsondiff::SaxToken::EndObject(rapidjson::SizeType)
+{
+    kind = END_OBJECT;
+    return true;
+}
+
+bool Linus::jsondiff::SaxToken::StartArray()
+{
+    kind = START_ARRAY;
+    return true;
+}
+
+bool Linus::jsondiff::SaxToken::EndArray(rapidjson::SizeType)
+{
+    kind = END_ARRAY;
+    return true;
+}
+
+//the string is referenced, not copied, so the value is only valid until the next token
+void Linus::jsondiff::SaxToken::to_value(rapidjson::Value& value)
+{
+    switch (scalar)
+    {
+    case 0:
+        value.SetNull();
+        break;
+    case 1:
+        value.SetBool(boolean);
+        break;
+    case 2:
+        value.SetInt(static_cast<int>(integer));
+        break;
+    case 3:
+        value.SetUint(static_cast<unsigned>(unsigned_integer));
+        break;
+    case 4:
+        value.SetInt64(integer);
+        break;
+    case 5:
+        value.SetUint64(unsigned_integer);
+        break;
+    case 6:
+        value.SetDouble(number);
+        break;
+    default:
+        value.SetString(rapidjson::StringRef(text.data(), text.size()));
+        break;
+    }
+}
+
+void Linus::jsondiff::SaxToken::to_value(rapidjson::Value& value, rapidjson::Document::AllocatorType& allocator)
+{
+    if (scalar == 7)
+    {
+        value.SetString(text.data(), static_cast<rapidjson::SizeType>(text.size()), allocator);
+    }
+    else
+    {
+        to_value(value);
+    }
+}
+
+Linus::jsondiff::StreamSide::StreamSide(const char* data, std::size_t size) : stream(data, size)
+{
+    reader.IterativeParseInit();
+}
+
+//pull exactly one token, false once the document is complete
+bool Linus::jsondiff::StreamSide::next()
+{
+    token.kind = Linus::jsondiff::SaxToken::NONE;
+    while (token.kind == Linus::jsondiff::SaxToken::NONE && !reader.IterativeParseComplete())
+    {
+        if (!reader.IterativeParseNext<rapidjson::kParseDefaultFlags>(stream, token) && reader.HasParseError())
+        {
+            std::ostringstream error;
+            error << "Parse error at offset " << reader.GetErrorOffset() << ": " << rapidjson::GetParseError_En(reader.GetParseErrorCode());
+            throw std::runtime_error(error.str());
+        }
+    }
+    return token.kind != Linus::jsondiff::SaxToken::NONE;
+}
+
+Linus::jsondiff::StreamDiffer::StreamDiffer(Linus::jsondiff::JsonDiffer& differ_input, const char* left_data, std::size_t left_size, const char* right_data, std::size_t right_size) : differ(differ_input), left(left_data, left_size), right(right_data, right_size), same(true)
+{
+
+}
+
+//fast mode without a DOM: both readers advance in lockstep and only subtrees that cannot be matched in stream order are built
+bool Linus::jsondiff::StreamDiffer::diff()
+{
+    Linus::jsondiff::StatTimer timer(Linus::jsondiff::Stats::DIFF);
+    same = true;
+    left.next();
+    right.next();
+    diff_value(nullptr, nullptr, nullptr);
+    left.next();
+    right.next();
+    if (differ.sink != nullptr)
+    {
+        differ.sink->flush();
+    }
+    return same;
+}
+
+void Linus::jsondiff::StreamDiffer::diff_value(const Linus::jsondiff::PathNode* left_path, const Linus::jsondiff::PathNode* right_path, const Linus::jsondiff::PathNode* up)
+{
+    Linus::jsondiff::Stats::count(Linus::jsondiff::Stats::NODES_VISITED, 1);
+    if (left.token.kind == Linus::jsondiff::SaxToken::START_OBJECT && right.token.kind == Linus::jsondiff::SaxToken::START_OBJECT)
+    {
+        diff_object(left_path, right_path);
+        return;
+    }
+    if (left.token.kind == Linus::jsondiff::SaxToken::START_ARRAY && right.token.kind == Linus::jsondiff::SaxToken::START_ARRAY)
+    {
+        diff_array(left_path, right_path);
+        return;
+    }
+    //scalars and mismatched types go through the DOM comparison, containers are built first
+    rapidjson::Value left_value, right_value;
+    std::unique_ptr<rapidjson::Document> left_tree, right_tree;
+    if (left.token.kind == Linus::jsondiff::SaxToken::SCALAR)
+    {
+        left.token.to_value(left_value);
+    }
+    else
+    {
+        left_tree.reset(new rapidjson::Document());
+        materialize(left, *left_tree, left_tree->GetAllocator());
+    }
+    if (right.token.kind == Linus::jsondiff::SaxToken::SCALAR)
+    {
+        right.token.to_value(right_value);
+    }
+    else
+    {
+        right_tree.reset(new rapidjson::Document());
+        materialize(right, *right_tree, right_tree->GetAllocator());
+    }
+    compare(left_tree ? *left_tree : left_value, right_tree ? *right_tree : right_value, left_path, right_path, up);
+}
+
+//keys in the same order are diffed while streaming, a key out of order is built and parked until its partner shows up.
+//A side whose key the other side has already parked fell behind and only it advances, so one inserted or removed key
+//parks O(1) values and the walk is back in lockstep; duplicated keys are parked side by side and pair in order
+void Linus::jsondiff::StreamDiffer::diff_object(const Linus::jsondiff::PathNode* left_path, const Linus::jsondiff::PathNode* right_path)
+{
+    std::multimap<std::string, std::unique_ptr<rapidjson::Document>> left_pending, right_pending;
+    bool left_open = true;
+    bool right_open = true;
+    bool has_left = false;
+    bool has_right = false;
+    std::string left_key, right_key;
+    const rapidjson::Value& emptyRef = empty_value;
+    while (left_open || right_open || has_left || has_right)
+    {
+        //a side with a key in hand is paused on the first token of its value
+        if (left_open && !has_left)
+        {
+            left.next();
+            if (left.token.kind == Linus::jsondiff::SaxToken::END_OBJECT)
+            {
+                left_open = false;
+            }
+            else
+            {
+                left_key = left.token.text;
+                left.next();
+                has_left = true;
+            }
+        }
+        if (right_open && !has_right)
+        {
+            right.next();
+            if (right.token.kind == Linus::jsondiff::SaxToken::END_OBJECT)
+            {
+                right_open = false;
+            }
+            else
+            {
+                right_key = right.token.text;
+                right.next();
+                has_right = true;
+            }
+        }
+        if (has_left && has_right && left_key == right_key)
+        {
+            Linus::jsondiff::PathNode left_node(left_path, left_key);
+            Linus::jsondiff::PathNode right_node(right_path, right_key);
+            diff_value(&left_node, &right_node, left_path);
+            has_left = false;
+            has_right = false;
+            continue;
+        }
+        bool caught_up = false;
+        auto left_match = has_left ? right_pending.find(left_key) : right_pending.end();
+        if (left_match != right_pending.end())
+        {
+            rapidjson::Document tree;
+            materialize(left, tree, tree.GetAllocator());
+            Linus::jsondiff::PathNode left_node(left_path, left_key);
+            Linus::jsondiff::PathNode right_node(right_path, left_key);
+            compare(tree, *left_match->second, &left_node, &right_node, left_path);
+            right_pending.erase(left_match);
+            has_left = false;
+            caught_up = true;
+        }
+        auto right_match = has_right ? left_pending.find(right_key) : left_pending.end();
+        if (right_match != left_pending.end())
+        {
+            rapidjson::Document tree;
+            materialize(right, tree, tree.GetAllocator());
+            Linus::jsondiff::PathNode left_node(left_path, right_key);
+            Linus::jsondiff::PathNode right_node(right_path, right_key);
+            compare(*right_match->second, tree, &left_node, &right_node, left_path);
+            left_pending.erase(right_match);
+            has_right = false;
+            caught_up = true;
+        }
+        if (caught_up)
+        {
+            continue;
+        }
+        //neither key has been seen on the other side yet; once that side is closed it never will be
+        if (has_left)
+        {
+            std::unique_ptr<rapidjson::Document> tree(new rapidjson::Document());
+            materialize(left, *tree, tree->GetAllocator());
+            if (right_open || has_right)
+            {
+                left_pending.emplace(left_key, std::move(tree));
+            }
+            else
+            {
+                Linus::jsondiff::PathNode left_node(left_path, left_key);
+                Linus::jsondiff::TreeLevel level_(*tree, emptyRef, &left_node, nullptr, left_path);
+                differ.report(EVENT_OBJECT_REMOVE, level_);
+                same = false;
+            }
+            has_left = false;
+        }
+        if (has_right)
+        {
+            std::unique_ptr<rapidjson::Document> tree(new rapidjson::Document());
+            materialize(right, *tree, tree->GetAllocator());
+            if (left_open)
+            {
+                right_pending.emplace(right_key, std::move(tree));
+            }
+            else
+            {
+                Linus::jsondiff::PathNode right_node(right_path, right_key);
+                Linus::jsondiff::TreeLevel level_(emptyRef, *tree, nullptr, &right_node, right_path);
+                differ.report(EVENT_OBJECT_ADD, level_);
+                same = false;
+            }
+            has_right = false;
+        }
+    }
+
+    for (const auto& item : left_pending)
+    {
+        Linus::jsondiff::PathNode left_node(left_path, item.first);
+        Linus::jsondiff::TreeLevel level_(*item.second, emptyRef, &left_node, nullptr, left_path);
+        differ.report(EVENT_OBJECT_REMOVE, level_);
+        same = false;
+    }
+    for (const auto& item : right_pending)
+    {
+        Linus::jsondiff::PathNode right_node(right_path, item.first);
+        Linus::jsondiff::TreeLevel level_(emptyRef, *item.second, nullptr, &right_node, right_path);
+        differ.report(EVENT_OBJECT_ADD, level_);
+        same = false;
+    }
+}
+
+//index-wise like compare_array_fast, the tail of the longer array is built one element at a time
+void Linus::jsondiff::StreamDiffer::diff_array(const Linus::jsondiff::PathNode* left_path, const Linus::jsondiff::PathNode* right_path)
+{
+    const rapidjson::Value& emptyRef = empty_value;
+    unsigned int index = 0;
+    left.next();
+    right.next();
+    while (left.token.kind != Linus::jsondiff::SaxToken::END_ARRAY && right.token.kind != Linus::jsondiff::SaxToken::END_ARRAY)
+    {
+        Linus::jsondiff::PathNode left_node(left_path, index);
+        Linus::jsondiff::PathNode right_node(right_path, index);
+        diff_value(&left_node, &right_node, left_path);
+        ++index;
+        left.next();
+        right.next();
+    }
+    for (unsigned int left_index = index; left.token.kind != Linus::jsondiff::SaxToken::END_ARRAY; ++left_index)
+    {
+        rapidjson::Document tree;
+        materialize(left, tree, tree.GetAllocator());
+        Linus::jsondiff::PathNode left_node(left_path, left_index);
+        Linus::jsondiff::TreeLevel level_(tree, emptyRef, &left_node, nullptr, left_path);
+        differ.report(EVENT_ARRAY_REMOVE, level_);
+        same = false;
+        left.next();
+    }
+    for (unsigned int right_index = index; right.token.kind != Linus::jsondiff::SaxToken::END_ARRAY; ++right_index)
+    {
+        rapidjson::Document tree;
+        materialize(right, tree, tree.GetAllocator());
+        Linus::jsondiff::PathNode right_node(right_path, right_index);
+        Linus::jsondiff::TreeLevel level_(emptyRef, tree, nullptr, &right_node, right_path);
+        differ.report(EVENT_ARRAY_ADD, level_);
+        same = false;
+        right.next();
+    }
+}
+
+void Linus::jsondiff::StreamDiffer::compare(const rapidjson::Value& left_value, const rapidjson::Value& right_value, const Linus::jsondiff::PathNode* left_path, const Linus::jsondiff::PathNode* right_path, const Linus::jsondiff::PathNode* up)
+{
+    Linus::jsondiff::TreeLevel level_(left_value, right_value, left_path, right_path, up);
+    //plain scalars need no digest, anything else gets one for the duration of the comparison like in the DOM mode
+    bool digest = level_.get_type() == 7 || left_value.IsObject() || left_value.IsArray();
+    if (digest)
+    {
+        differ.build_digest(left_value);
+        differ.build_digest(right_value);
+    }
+    if (differ.diff_level(level_, false) != 1.0)
+    {
+        same = false;
+    }
+    if (digest)
+    {
+        differ.drop_digest(left_value);
+        differ.drop_digest(right_value);
+    }
+}
+
+//build the value starting at the current token, leaves the side on its last token
+void Linus::jsondiff::StreamDiffer::materialize(Linus::jsondiff::StreamSide& side, rapidjson::Value& value, rapidjson::Document::AllocatorType& allocator)
+{
+    if (side.token.kind == Linus::jsondiff::SaxToken::START_OBJECT)
+    {
+        value.SetObject();
+        while (side.next() && side.token.kind != Linus::jsondiff::SaxToken::END_OBJECT)
+        {
+            rapidjson::Value name(side.token.text.data(), static_cast<rapidjson::SizeType>(side.token.text.size()), allocator);
+            side.next();
+            rapidjson::Value member;
+            materialize(side, member, allocator);
+            value.AddMember(name, member, allocator);
+        }
+    }
+    else if (side.token.kind == Linus::jsondiff::SaxToken::START_ARRAY)
+    {
+        value.SetArray();
+        while (side.next() && side.token.kind != Linus::jsondiff::SaxToken::END_ARRAY)
+        {
+            rapidjson::Value element;
+            materialize(side, element, allocator);
+            value.PushBack(element, allocator);
+        }
+    }
+    else
+    {
+        side.token.to_value(value, allocator);
+    }
 }
 
 Linus::jsondiff::BottomUpLCS::BottomUpLCS(Linus::jsondiff::TreeLevel& level, Linus::jsondiff::JsonDiffer& differ) : level(level), differ(differ)
@@ -1261,7 +3881,8 @@ void Linus::jsondiff::BottomUpLCS::inter_LCS(const rapidjson::Value* ptr_left, c
     {
         type_right.push_back(differ.get_type(right[j]));
     }
-    std::vector<std::vector<double>> dp(len_left + 1, std::vector<double>(len_right + 1, 0.0));
+    std::vector<double> previous(len_right + 1, 0.0);
+    std::vector<double> current(len_right + 1, 0.0);
     for (unsigned int i = 1; i <= len_left; ++i)
     {
         for (unsigned int j = 1; j <= len_right; ++j)
@@ -1282,7 +3903,7 @@ void Linus::jsondiff::BottomUpLCS::inter_LCS(const rapidjson::Value* ptr_left, c
                         break;
                     }
                     case 2:
-                        score_ = (std::strcmp(left[i-1].GetString(), right[j-1].GetString()));
+                        score_ = (std::strcmp(left[i-1].GetString(), right[j-1].GetString()) == 0);
                         break;
                     case 3:
                         score_ = (left[i-1].GetInt() == right[j-1].GetInt());
@@ -1307,15 +3928,16 @@ void Linus::jsondiff::BottomUpLCS::inter_LCS(const rapidjson::Value* ptr_left, c
             }
             if (score_ >= differ.SIMILARITY_THRESHOLD)
             {
-                dp[i][j] = dp[i - 1][j - 1] + score_;
+                current[j] = previous[j - 1] + score_;
             }
             else
             {
-                dp[i][j] = std::max(dp[i - 1][j], dp[i][j - 1]);
+                current[j] = std::max(previous[j], current[j - 1]);
             }
         }
+        previous.swap(current);
     }
-    history[layer][ptr_left][ptr_right] = dp[len_left][len_right] / max(len_left, len_right);
+    history[layer][ptr_left][ptr_right] = previous[len_right] / max(len_left, len_right);
 }
 
 double Linus::jsondiff::BottomUpLCS::compare_object(const rapidjson::Value& left, const rapidjson::Value& right, unsigned int layer)
@@ -1414,7 +4036,7 @@ std::map<unsigned int, unsigned int> Linus::jsondiff::BottomUpLCS::LCS()
                         break;
                     }
                     case 2:
-                        score_ = (std::strcmp(level.left[i-1].GetString(), level.right[j-1].GetString()));
+                        score_ = (std::strcmp(level.left[i-1].GetString(), level.right[j-1].GetString()) == 0);
                         break;
                     case 3:
                         score_ = (level.left[i-1].GetInt() == level.right[j-1].GetInt());
@@ -1468,7 +4090,7 @@ std::map<unsigned int, unsigned int> Linus::jsondiff::BottomUpLCS::LCS()
                     break;
                 }
                 case 2:
-                    score_ = (std::strcmp(level.left[i - 1].GetString(), level.right[j - 1].GetString()));
+                    score_ = (std::strcmp(level.left[i - 1].GetString(), level.right[j - 1].GetString()) == 0);
                     break;
                 case 3:
                     score_ = (level.left[i - 1].GetInt() == level.right[j - 1].GetInt());